@@ -0,0 +1,427 @@
+/*============================================================================
+
+  fblife
+  control.c
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  Control listens on a Unix domain socket for commands from other
+  programs, which might be as simple as
+
+    echo stats | socat - UNIX-CONNECT:/run/fblife.sock
+
+  A command is one line of text. Control itself does not understand the
+  commands; it has its own thread, which uses epoll to wait for
+  connections and input from any number of clients, and puts each
+  complete line on a queue. The main loop takes the commands off the
+  queue between generations, using control_get_command(), which never
+  blocks, so the simulation is not held up by slow or idle clients.
+  The main loop's replies go back through another queue to the thread,
+  which sends them to the client that sent the command, if it is still
+  connected. Clients are identified by a number that is never reused,
+  rather than by file descriptor, so a reply can't go to the wrong
+  client.
+
+============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "defs.h"
+#include "log.h"
+#include "list.h"
+#include "control.h"
+
+// epoll data for the two file descriptors that are not clients; for
+//   clients, it is the slot in the clients array
+#define CONTROL_EVENT_LISTEN UINT32_MAX
+#define CONTROL_EVENT_WAKE (UINT32_MAX - 1)
+
+typedef struct _ControlClient
+  {
+  int id;
+  int fd; // -1 if this slot is free
+  char buff [CONTROL_MAX_LINE];
+  int len;
+  } ControlClient;
+
+// A command or reply, on one of the queues
+typedef struct _ControlMessage
+  {
+  int client;
+  char *text;
+  } ControlMessage;
+
+struct _Control
+  {
+  char *path;
+  int listen_fd;
+  int epoll_fd;
+  int wake_fd; // eventfd, to wake the thread to send replies, or stop
+  pthread_t thread;
+  BOOL stop;
+  List *commands;
+  List *replies;
+  // Only the thread uses these
+  ControlClient clients [CONTROL_MAX_CLIENTS];
+  int next_id;
+  };
+
+
+/*==========================================================================
+  control_message_free
+*==========================================================================*/
+static void control_message_free (void *p)
+  {
+  ControlMessage *message = p;
+  free (message->text);
+  free (message);
+  }
+
+
+/*==========================================================================
+  control_close_client
+*==========================================================================*/
+static void control_close_client (Control *self, ControlClient *client)
+  {
+  log_debug ("Control client %d disconnected", client->id);
+  epoll_ctl (self->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+  close (client->fd);
+  client->fd = -1;
+  }
+
+
+/*==========================================================================
+  control_accept
+*==========================================================================*/
+static void control_accept (Control *self)
+  {
+  int fd = accept4 (self->listen_fd, NULL, NULL,
+    SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0) return;
+  int slot = -1;
+  for (int i = 0; i < CONTROL_MAX_CLIENTS && slot < 0; i++)
+    if (self->clients[i].fd < 0) slot = i;
+  if (slot < 0)
+    {
+    static const char *msg = "ERROR Too many clients\n";
+    send (fd, msg, strlen (msg), MSG_NOSIGNAL | MSG_DONTWAIT);
+    close (fd);
+    return;
+    }
+  ControlClient *client = &self->clients[slot];
+  client->id = self->next_id++;
+  client->fd = fd;
+  client->len = 0;
+  struct epoll_event ev;
+  memset (&ev, 0, sizeof (ev));
+  ev.events = EPOLLIN;
+  ev.data.u32 = slot;
+  epoll_ctl (self->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+  log_debug ("Control client %d connected", client->id);
+  }
+
+
+/*==========================================================================
+
+  control_read
+
+  Read what the client has sent, and queue any complete lines. A line
+  that is too long is discarded.
+
+*==========================================================================*/
+static void control_read (Control *self, ControlClient *client)
+  {
+  int n = read (client->fd, client->buff + client->len,
+    CONTROL_MAX_LINE - client->len);
+  if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+  if (n <= 0)
+    {
+    control_close_client (self, client);
+    return;
+    }
+  client->len += n;
+
+  char *start = client->buff;
+  char *end = client->buff + client->len;
+  char *nl;
+  while ((nl = memchr (start, '\n', end - start)))
+    {
+    char *p = nl;
+    if (p > start && p[-1] == '\r') p--;
+    if (p > start)
+      {
+      ControlMessage *command = malloc (sizeof (ControlMessage));
+      command->client = client->id;
+      command->text = strndup (start, p - start);
+      list_append (self->commands, command);
+      }
+    start = nl + 1;
+    }
+  client->len = end - start;
+  memmove (client->buff, start, client->len);
+
+  if (client->len == CONTROL_MAX_LINE)
+    {
+    static const char *msg = "ERROR Line too long\n";
+    send (client->fd, msg, strlen (msg), MSG_NOSIGNAL | MSG_DONTWAIT);
+    client->len = 0;
+    }
+  }
+
+
+/*==========================================================================
+
+  control_send_replies
+
+  Send each queued reply to its client, if it is still there. Replies
+  are short, and clients are expected to read them, so if the socket
+  buffer is full, the reply is simply lost
+
+*==========================================================================*/
+static void control_send_replies (Control *self)
+  {
+  ControlMessage *reply;
+  while ((reply = list_take_first (self->replies)))
+    {
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++)
+      {
+      ControlClient *client = &self->clients[i];
+      if (client->fd >= 0 && client->id == reply->client)
+        send (client->fd, reply->text, strlen (reply->text),
+          MSG_NOSIGNAL | MSG_DONTWAIT);
+      }
+    control_message_free (reply);
+    }
+  }
+
+
+/*==========================================================================
+  control_thread
+*==========================================================================*/
+static void *control_thread (void *arg)
+  {
+  Control *self = arg;
+  while (!__atomic_load_n (&self->stop, __ATOMIC_ACQUIRE))
+    {
+    struct epoll_event events[8];
+    int n = epoll_wait (self->epoll_fd, events, 8, -1);
+    if (n < 0 && errno != EINTR)
+      {
+      log_error ("Control socket: %s", strerror (errno));
+      break;
+      }
+    for (int i = 0; i < n; i++)
+      {
+      uint32_t what = events[i].data.u32;
+      if (what == CONTROL_EVENT_LISTEN)
+        control_accept (self);
+      else if (what == CONTROL_EVENT_WAKE)
+        {
+        uint64_t count;
+        if (read (self->wake_fd, &count, sizeof (count)) < 0)
+          {
+          // Nothing to do -- another event will follow
+          }
+        control_send_replies (self);
+        }
+      else if (self->clients[what].fd >= 0)
+        control_read (self, &self->clients[what]);
+      }
+    }
+  return NULL;
+  }
+
+
+/*==========================================================================
+  control_add_fd
+*==========================================================================*/
+static void control_add_fd (Control *self, int fd, uint32_t what)
+  {
+  struct epoll_event ev;
+  memset (&ev, 0, sizeof (ev));
+  ev.events = EPOLLIN;
+  ev.data.u32 = what;
+  epoll_ctl (self->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+  }
+
+
+/*==========================================================================
+
+  control_create
+
+  Listen on a Unix domain socket at the given path, replacing any
+  existing socket there, but not any other kind of file. Only the
+  owner can connect. Returns NULL, and sets error, if the socket
+  can't be set up.
+
+*==========================================================================*/
+Control *control_create (const char *path, char **error)
+  {
+  LOG_IN
+  struct sockaddr_un addr;
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen (path) >= sizeof (addr.sun_path))
+    {
+    if (error) asprintf (error, "Control socket path is too long");
+    LOG_OUT
+    return NULL;
+    }
+  strcpy (addr.sun_path, path);
+
+  int fd = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    {
+    if (error) asprintf (error, "Can't create socket: %s", strerror (errno));
+    LOG_OUT
+    return NULL;
+    }
+  struct stat sb;
+  if (lstat (path, &sb) == 0)
+    {
+    if (!S_ISSOCK (sb.st_mode))
+      {
+      if (error) asprintf (error, "%s exists, and is not a socket", path);
+      close (fd);
+      LOG_OUT
+      return NULL;
+      }
+    unlink (path);
+    }
+  // The socket is created with the umask's permissions, so narrow it
+  //   for the bind(), so that there is no moment when others can connect
+  mode_t old_mask = umask (S_IRWXG | S_IRWXO);
+  int bound = bind (fd, (struct sockaddr *)&addr, sizeof (addr));
+  umask (old_mask);
+  if (bound != 0 || listen (fd, 4) != 0)
+    {
+    if (error) asprintf (error, "Can't listen on %s: %s", path,
+      strerror (errno));
+    close (fd);
+    LOG_OUT
+    return NULL;
+    }
+
+  Control *self = malloc (sizeof (Control));
+  self->path = strdup (path);
+  self->listen_fd = fd;
+  self->epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+  self->wake_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  self->stop = FALSE;
+  self->commands = list_create (control_message_free);
+  self->replies = list_create (control_message_free);
+  for (int i = 0; i < CONTROL_MAX_CLIENTS; i++)
+    self->clients[i].fd = -1;
+  self->next_id = 1;
+  control_add_fd (self, self->listen_fd, CONTROL_EVENT_LISTEN);
+  control_add_fd (self, self->wake_fd, CONTROL_EVENT_WAKE);
+  pthread_create (&self->thread, NULL, control_thread, self);
+  log_info ("Listening for commands on %s", path);
+  LOG_OUT
+  return self;
+  }
+
+
+/*==========================================================================
+  control_wake
+*==========================================================================*/
+static void control_wake (Control *self)
+  {
+  uint64_t one = 1;
+  if (write (self->wake_fd, &one, sizeof (one)) < 0)
+    {
+    // Only fails if the counter is about to overflow, in which case
+    //   the thread has plenty of wake-ups pending already
+    }
+  }
+
+
+/*==========================================================================
+
+  control_destroy
+
+  Stop the thread, disconnect the clients, and remove the socket
+
+*==========================================================================*/
+void control_destroy (Control *self)
+  {
+  LOG_IN
+  if (self)
+    {
+    __atomic_store_n (&self->stop, TRUE, __ATOMIC_RELEASE);
+    control_wake (self);
+    pthread_join (self->thread, NULL);
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++)
+      if (self->clients[i].fd >= 0) close (self->clients[i].fd);
+    close (self->listen_fd);
+    close (self->epoll_fd);
+    close (self->wake_fd);
+    unlink (self->path);
+    free (self->path);
+    list_destroy (self->commands);
+    list_destroy (self->replies);
+    free (self);
+    }
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+
+  control_get_command
+
+  Take the next command off the queue, if there is one, and set client
+  to the client that sent it, for control_reply. The caller must free
+  the result. Returns NULL, without waiting, if there are no commands.
+
+*==========================================================================*/
+char *control_get_command (Control *self, int *client)
+  {
+  char *ret = NULL;
+  ControlMessage *command = list_take_first (self->commands);
+  if (command)
+    {
+    ret = command->text;
+    *client = command->client;
+    free (command);
+    }
+  return ret;
+  }
+
+
+/*==========================================================================
+
+  control_reply
+
+  Send a line of text to a client. A newline is added. This does not
+  wait for the text to be sent.
+
+*==========================================================================*/
+void control_reply (Control *self, int client, const char *fmt, ...)
+  {
+  va_list ap;
+  va_start (ap, fmt);
+  char *s;
+  if (vasprintf (&s, fmt, ap) >= 0)
+    {
+    ControlMessage *reply = malloc (sizeof (ControlMessage));
+    reply->client = client;
+    asprintf (&reply->text, "%s\n", s);
+    free (s);
+    list_append (self->replies, reply);
+    control_wake (self);
+    }
+  va_end (ap);
+  }
+
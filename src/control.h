@@ -0,0 +1,29 @@
+/*============================================================================
+
+  fblife
+  control.h
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+============================================================================*/
+
+#pragma once
+
+#include "defs.h"
+
+// The longest command line that a client can send
+#define CONTROL_MAX_LINE 1024
+// The most clients that can be connected at the same time
+#define CONTROL_MAX_CLIENTS 16
+
+struct _Control;
+typedef struct _Control Control;
+
+BEGIN_DECLS
+
+Control    *control_create (const char *path, char **error);
+void        control_destroy (Control *self);
+char       *control_get_command (Control *self, int *client);
+void        control_reply (Control *self, int client, const char *fmt, ...);
+
+END_DECLS
+
@@ -27,6 +27,10 @@
 // If defined, includes in the build support for zipfile processing
 //#define FEATURE_ZIPFILE 1
 
+// If defined, includes in the build the trace-event recorder, which the
+//   --trace option turns on. If not, the trace points compile to nothing
+#define FEATURE_TRACE 1
+
 // Include number conversion functions. If defined, the application
 //  will have to be linked with the standard math library
 //#define FEATURE_NUMCONVERSION 1
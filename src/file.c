@@ -214,7 +214,7 @@ BOOL file_expand_directory (const char *path,
     //   must exist for us to have gotten this far
     char *start_fullpath = realpath (path, NULL);
 
-    List *list = list_create ((ListItemFreeFn)string_destroy);
+    List *list = list_create_unlocked ((ListItemFreeFn)string_destroy);
     struct dirent *de;
     while ((de = readdir (d)))
       {
@@ -39,6 +39,11 @@ struct _FrameBuffer
   int fb_bytes;
   int stride;
   BOOL linear;
+  BOOL in_memory; // Allocated by framebuffer_create_memory, not mapped
+  // Position and size of each colour's bits in a pixel
+  int red_offset, red_length;
+  int green_offset, green_length;
+  int blue_offset, blue_length;
   }; 
 
 
@@ -53,6 +58,51 @@ FrameBuffer *framebuffer_create (const char *fbdev)
   self->fd = -1;
   self->fb_data = NULL;
   self->fb_data_size = 0;
+  self->in_memory = FALSE;
+  LOG_OUT 
+  return self;
+  }
+
+
+/*==========================================================================
+
+  framebuffer_create_memory
+
+  Create a framebuffer in ordinary memory, rather than on a device, 
+  for testing and benchmarks. It is ready to use, without 
+  framebuffer_init, and is cleared to black. bpp is 16, for RGB565, 
+  or 24 or 32, for 8-bit RGB, in the layouts that Linux framebuffers
+  usually have. Returns NULL if bpp is anything else.
+
+*==========================================================================*/
+FrameBuffer *framebuffer_create_memory (int w, int h, int bpp)
+  {
+  LOG_IN
+  FrameBuffer *self = NULL;
+  if (bpp == 16 || bpp == 24 || bpp == 32)
+    {
+    self = framebuffer_create ("memory");
+    self->w = w;
+    self->h = h;
+    self->fb_bytes = bpp / 8;
+    self->stride = w * self->fb_bytes;
+    self->linear = TRUE;
+    self->fb_data_size = self->stride * h;
+    self->fb_data = calloc (self->fb_data_size, 1);
+    self->in_memory = TRUE;
+    if (bpp == 16)
+      {
+      self->red_offset = 11; self->red_length = 5;
+      self->green_offset = 5; self->green_length = 6;
+      self->blue_offset = 0; self->blue_length = 5;
+      }
+    else
+      {
+      self->red_offset = 16; self->red_length = 8;
+      self->green_offset = 8; self->green_length = 8;
+      self->blue_offset = 0; self->blue_length = 8;
+      }
+    }
   LOG_OUT 
   return self;
   }
@@ -86,6 +136,12 @@ BOOL framebuffer_init (FrameBuffer *self, char **error)
     self->fb_bytes = fb_bytes;
     self->stride = finfo.line_length;
     self->fb_data_size = self->stride * self->h;
+    self->red_offset = vinfo.red.offset;
+    self->red_length = vinfo.red.length;
+    self->green_offset = vinfo.green.offset;
+    self->green_length = vinfo.green.length;
+    self->blue_offset = vinfo.blue.offset;
+    self->blue_length = vinfo.blue.length;
 
     if (self->stride == self->w * self->fb_bytes)
       self->linear = TRUE;
@@ -117,7 +173,10 @@ void framebuffer_deinit (FrameBuffer *self)
     {
     if (self->fb_data) 
       {
-      munmap (self->fb_data, self->fb_data_size);
+      if (self->in_memory)
+        free (self->fb_data);
+      else
+        munmap (self->fb_data, self->fb_data_size);
       self->fb_data = NULL;
       }
     if (self->fd != -1)
@@ -130,6 +189,20 @@ void framebuffer_deinit (FrameBuffer *self)
   }
 
 
+/*==========================================================================
+  framebuffer_map_rgb
+
+  Convert a colour to the framebuffer's native pixel format. The 
+  result is in the low-order framebuffer_get_bytes_per_pixel() bytes
+*==========================================================================*/
+uint32_t framebuffer_map_rgb (const FrameBuffer *self, BYTE r, BYTE g, 
+      BYTE b)
+  {
+  return (uint32_t)(r >> (8 - self->red_length)) << self->red_offset
+    | (uint32_t)(g >> (8 - self->green_length)) << self->green_offset
+    | (uint32_t)(b >> (8 - self->blue_length)) << self->blue_offset;
+  }
+
 /*==========================================================================
   framebuffer_set_pixel
 *==========================================================================*/
@@ -138,12 +211,12 @@ void framebuffer_set_pixel (FrameBuffer *self, int x, int y,
   {
   if (x >= 0 && x < self->w && y >= 0 && y < self->h)
     {
-    int index32 = (y * self->stride) + (x * self->fb_bytes);
-    assert(index32 <= (self->fb_data_size - self->fb_bytes));
-    self->fb_data [index32++] = b;
-    self->fb_data [index32++] = g;
-    self->fb_data [index32++] = r;
-    self->fb_data [index32] = 0;
+    int index = (y * self->stride) + (x * self->fb_bytes);
+    assert(index <= (self->fb_data_size - self->fb_bytes));
+    uint32_t pixel = framebuffer_map_rgb (self, r, g, b);
+    // Pixels are stored little-endian
+    for (int i = 0; i < self->fb_bytes; i++)
+      self->fb_data [index + i] = pixel >> (8 * i);
     }
   }
 
@@ -186,11 +259,14 @@ void framebuffer_get_pixel (const FrameBuffer *self,
   {
   if (x >= 0 && x < self->w && y >= 0 && y < self->h)
     {
-    int index32 = (y * self->stride) + (x * self->fb_bytes);
-    assert(index32 <= (self->fb_data_size - self->fb_bytes));
-    *b = self->fb_data [index32++];
-    *g = self->fb_data [index32++];
-    *r = self->fb_data [index32];
+    int index = (y * self->stride) + (x * self->fb_bytes);
+    assert(index <= (self->fb_data_size - self->fb_bytes));
+    uint32_t pixel = 0;
+    for (int i = 0; i < self->fb_bytes; i++)
+      pixel |= (uint32_t)self->fb_data [index + i] << (8 * i);
+    *r = ((pixel >> self->red_offset) << (8 - self->red_length)) & 0xFF;
+    *g = ((pixel >> self->green_offset) << (8 - self->green_length)) & 0xFF;
+    *b = ((pixel >> self->blue_offset) << (8 - self->blue_length)) & 0xFF;
     }
   else
     {
@@ -209,6 +285,27 @@ BYTE *framebuffer_get_data (FrameBuffer *self)
   }
 
 
+/*==========================================================================
+  framebuffer_get_bytes_per_pixel
+*==========================================================================*/
+int framebuffer_get_bytes_per_pixel (const FrameBuffer *self)
+  {
+  return self->fb_bytes;
+  }
+
+
+/*==========================================================================
+  framebuffer_get_stride
+
+  The number of bytes from the start of one line to the start of the
+  next
+*==========================================================================*/
+int framebuffer_get_stride (const FrameBuffer *self)
+  {
+  return self->stride;
+  }
+
+
 /*==========================================================================
   framebuffer_is_linear
 
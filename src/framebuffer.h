@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <stdint.h>
 #include "defs.h"
 
 struct _FrameBuffer;
@@ -16,6 +17,7 @@ typedef struct _FrameBuffer FrameBuffer;
 BEGIN_DECLS
 
 FrameBuffer     *framebuffer_create (const char *fbdev);
+FrameBuffer     *framebuffer_create_memory (int w, int h, int bpp);
 BOOL             framebuffer_init (FrameBuffer *self, char **error);
 void             framebuffer_deinit (FrameBuffer *self);
 void             framebuffer_destroy (FrameBuffer *self);
@@ -27,6 +29,10 @@ void             framebuffer_get_pixel (const FrameBuffer *self,
                       int x, int y, BYTE *r, BYTE *g, BYTE *b);
 BYTE            *framebuffer_get_data (FrameBuffer *self);
 BOOL             framebuffer_is_linear (FrameBuffer *self);
+int              framebuffer_get_bytes_per_pixel (const FrameBuffer *self);
+int              framebuffer_get_stride (const FrameBuffer *self);
+uint32_t         framebuffer_map_rgb (const FrameBuffer *self, 
+                      BYTE r, BYTE g, BYTE b);
 void             framebuffer_clear (FrameBuffer *self);
 
 END_DECLS
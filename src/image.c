@@ -0,0 +1,325 @@
+/*============================================================================
+
+  fblife
+  image.c
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  Write a Region to an image file, either as a binary PPM or as a PNG.
+  Both are written without any library. PPM is just a short text
+  header followed by the RGB pixels. A PNG must hold its pixels in a
+  zlib stream, but that stream can use deflate's "stored" blocks, which
+  hold data uncompressed, so no compressor is needed -- only the CRC-32
+  of each chunk and the Adler-32 of the pixels. The result is a little
+  larger than the PPM, but that suits a program that writes a lot of
+  small images quickly, and anything that needs them smaller can
+  recompress them later.
+
+============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <stdint.h>
+#include "defs.h"
+#include "log.h"
+#include "region.h"
+#include "image.h"
+
+// The most data a stored deflate block can hold
+#define IMAGE_STORED_BLOCK 65535
+// The most bytes that can be summed before the Adler-32 sums must be
+//   reduced, to avoid overflowing 32 bits
+#define IMAGE_ADLER_NMAX 5552
+
+
+/*==========================================================================
+
+  image_rgb_row
+
+  Convert a row of the Region's BGR pixels to RGB
+
+*==========================================================================*/
+static void image_rgb_row (const BYTE *in, BYTE *out, int w)
+  {
+  for (int i = 0; i < w; i++, in += 3, out += 3)
+    {
+    out[0] = in[2];
+    out[1] = in[1];
+    out[2] = in[0];
+    }
+  }
+
+
+/*==========================================================================
+
+  image_crc32
+
+  Continue a CRC-32, as used by PNG, over n more bytes. Start with
+  crc = 0. The table is built the first time it is needed.
+
+*==========================================================================*/
+static uint32_t image_crc32 (uint32_t crc, const BYTE *data, size_t n)
+  {
+  static uint32_t table[256];
+  static BOOL have_table = FALSE;
+  if (!have_table)
+    {
+    for (uint32_t i = 0; i < 256; i++)
+      {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      table[i] = c;
+      }
+    have_table = TRUE;
+    }
+  crc = ~crc;
+  for (size_t i = 0; i < n; i++)
+    crc = table [(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+  }
+
+
+/*==========================================================================
+
+  image_adler32
+
+  The Adler-32 checksum that ends a zlib stream
+
+*==========================================================================*/
+static uint32_t image_adler32 (const BYTE *data, size_t n)
+  {
+  uint32_t a = 1, b = 0;
+  while (n > 0)
+    {
+    size_t len = n < IMAGE_ADLER_NMAX ? n : IMAGE_ADLER_NMAX;
+    n -= len;
+    while (len--)
+      {
+      a += *data++;
+      b += a;
+      }
+    a %= 65521;
+    b %= 65521;
+    }
+  return (b << 16) | a;
+  }
+
+
+/*==========================================================================
+  image_put_be32
+*==========================================================================*/
+static void image_put_be32 (BYTE *p, uint32_t v)
+  {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+  }
+
+
+/*==========================================================================
+
+  image_png_write
+
+  Write part of a chunk's type or data, adding it to the chunk's CRC.
+  Returns FALSE if writing fails.
+
+*==========================================================================*/
+static BOOL image_png_write (FILE *f, uint32_t *crc, const BYTE *data,
+       size_t n)
+  {
+  *crc = image_crc32 (*crc, data, n);
+  return fwrite (data, 1, n, f) == n;
+  }
+
+
+/*==========================================================================
+
+  image_png_start_chunk
+
+  Write a chunk's length and type, and start its CRC, which covers the
+  type and the data
+
+*==========================================================================*/
+static BOOL image_png_start_chunk (FILE *f, uint32_t *crc,
+       const char *type, uint32_t length)
+  {
+  BYTE len[4];
+  image_put_be32 (len, length);
+  *crc = 0;
+  return fwrite (len, 1, 4, f) == 4
+    && image_png_write (f, crc, (const BYTE *)type, 4);
+  }
+
+
+/*==========================================================================
+  image_png_end_chunk
+*==========================================================================*/
+static BOOL image_png_end_chunk (FILE *f, uint32_t crc)
+  {
+  BYTE b[4];
+  image_put_be32 (b, crc);
+  return fwrite (b, 1, 4, f) == 4;
+  }
+
+
+/*==========================================================================
+
+  image_write_png
+
+  Write the whole PNG: the signature, then the IHDR, IDAT, and IEND
+  chunks. The IDAT holds a zlib stream of stored blocks, containing
+  the rows, each preceded by a zero byte to say that it is not
+  filtered. Returns FALSE if writing fails, or the image is too large
+  for a single IDAT chunk.
+
+*==========================================================================*/
+static BOOL image_write_png (const Region *region, FILE *f)
+  {
+  static const BYTE signature[8] =
+    { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  int w = region_get_width (region), h = region_get_height (region);
+  size_t row_bytes = 1 + (size_t)w * 3;
+  size_t raw_len = row_bytes * h;
+  size_t nblocks = (raw_len + IMAGE_STORED_BLOCK - 1) / IMAGE_STORED_BLOCK;
+  if (nblocks == 0) nblocks = 1;
+  size_t idat_len = 2 + 5 * nblocks + raw_len + 4;
+  if (idat_len > INT32_MAX)
+    {
+    errno = EFBIG;
+    return FALSE;
+    }
+
+  BYTE *raw = malloc (raw_len);
+  const BYTE *data = region_get_data (region);
+  for (int y = 0; y < h; y++)
+    {
+    BYTE *row = raw + y * row_bytes;
+    row[0] = 0;
+    image_rgb_row (data + (size_t)y * w * 3, row + 1, w);
+    }
+
+  BOOL ok = fwrite (signature, 1, 8, f) == 8;
+
+  uint32_t crc;
+  BYTE ihdr[13];
+  image_put_be32 (ihdr, w);
+  image_put_be32 (ihdr + 4, h);
+  ihdr[8] = 8; // Bits per sample
+  ihdr[9] = 2; // Colour type: RGB
+  ihdr[10] = 0; // Compression: deflate
+  ihdr[11] = 0; // Filter method
+  ihdr[12] = 0; // No interlace
+  ok = ok && image_png_start_chunk (f, &crc, "IHDR", sizeof (ihdr))
+    && image_png_write (f, &crc, ihdr, sizeof (ihdr))
+    && image_png_end_chunk (f, crc);
+
+  // zlib header: deflate, 32k window, no dictionary, fastest level
+  static const BYTE zlib_header[2] = { 0x78, 0x01 };
+  ok = ok && image_png_start_chunk (f, &crc, "IDAT", idat_len)
+    && image_png_write (f, &crc, zlib_header, 2);
+  size_t done = 0;
+  for (size_t i = 0; ok && i < nblocks; i++)
+    {
+    size_t len = raw_len - done;
+    if (len > IMAGE_STORED_BLOCK) len = IMAGE_STORED_BLOCK;
+    BYTE header[5];
+    header[0] = (i == nblocks - 1) ? 1 : 0; // BFINAL, and type 0
+    header[1] = len & 0xFF;
+    header[2] = len >> 8;
+    header[3] = ~len & 0xFF;
+    header[4] = (~len >> 8) & 0xFF;
+    ok = image_png_write (f, &crc, header, 5)
+      && image_png_write (f, &crc, raw + done, len);
+    done += len;
+    }
+  BYTE adler[4];
+  image_put_be32 (adler, image_adler32 (raw, raw_len));
+  ok = ok && image_png_write (f, &crc, adler, 4)
+    && image_png_end_chunk (f, crc);
+
+  ok = ok && image_png_start_chunk (f, &crc, "IEND", 0)
+    && image_png_end_chunk (f, crc);
+
+  free (raw);
+  return ok;
+  }
+
+
+/*==========================================================================
+
+  image_write_ppm
+
+  Returns FALSE if writing fails
+
+*==========================================================================*/
+static BOOL image_write_ppm (const Region *region, FILE *f)
+  {
+  int w = region_get_width (region), h = region_get_height (region);
+  BOOL ok = fprintf (f, "P6\n%d %d\n255\n", w, h) > 0;
+  BYTE *row = malloc ((size_t)w * 3);
+  const BYTE *data = region_get_data (region);
+  for (int y = 0; ok && y < h; y++)
+    {
+    image_rgb_row (data + (size_t)y * w * 3, row, w);
+    ok = fwrite (row, 3, w, f) == (size_t)w;
+    }
+  free (row);
+  return ok;
+  }
+
+
+/*==========================================================================
+
+  image_write
+
+  Write the region to a file, replacing it if it exists. Returns FALSE,
+  and sets error, if the file can't be written.
+
+*==========================================================================*/
+BOOL image_write (const Region *region, const char *filename,
+       ImageFormat format, char **error)
+  {
+  LOG_IN
+  BOOL ret = FALSE;
+  FILE *f = fopen (filename, "w");
+  if (f)
+    {
+    if (format == IMAGE_FORMAT_PNG)
+      ret = image_write_png (region, f);
+    else
+      ret = image_write_ppm (region, f);
+    int err = errno;
+    if (fclose (f) != 0 && ret)
+      {
+      err = errno;
+      ret = FALSE;
+      }
+    errno = err;
+    }
+  if (!ret && error)
+    asprintf (error, "Can't write %s: %s", filename, strerror (errno));
+  LOG_OUT
+  return ret;
+  }
+
+
+/*==========================================================================
+
+  image_format_from_filename
+
+  PNG if the name ends in ".png", and PPM otherwise
+
+*==========================================================================*/
+ImageFormat image_format_from_filename (const char *filename)
+  {
+  const char *ext = strrchr (filename, '.');
+  if (ext && strcasecmp (ext, ".png") == 0)
+    return IMAGE_FORMAT_PNG;
+  return IMAGE_FORMAT_PPM;
+  }
+
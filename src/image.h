@@ -0,0 +1,27 @@
+/*============================================================================
+
+  fblife
+  image.h
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+============================================================================*/
+
+#pragma once
+
+#include "defs.h"
+#include "region.h"
+
+typedef enum
+  {
+  IMAGE_FORMAT_PPM, // Binary ("P6") portable pixmap
+  IMAGE_FORMAT_PNG  // 24-bit RGB PNG, uncompressed
+  } ImageFormat;
+
+BEGIN_DECLS
+
+BOOL        image_write (const Region *region, const char *filename,
+              ImageFormat format, char **error);
+ImageFormat image_format_from_filename (const char *filename);
+
+END_DECLS
+
@@ -7,6 +7,78 @@
   Life is a class for carrying out the evolution of a game-of-life
   simulation.
 
+  Each cell holds a state number -- 0 for dead, 1 for alive and, for
+  Generations rules, 2 upwards for dying cells. See rule.c for
+  details. The rule is compiled into a transition table, so working
+  out the new state of a cell is just a matter of counting the live
+  cells in its neighbourhood and doing one table lookup.
+
+  Each neighbourhood (Moore, hexagonal, von Neumann, Larger than Life)
+  has its own update function, selected once per generation, so that
+  the inner loops do not have to test which kind of rule is in use.
+
+  In the hexagonal grid, odd-numbered rows are taken to be offset to 
+  the right by half a cell. So a cell in an even row has neighbours at
+  columns x - 1 and x in the rows above and below, while a cell in an
+  odd row has neighbours at x and x + 1. For the wrap-around to be 
+  consistent, the height should be even.
+
+  For isotropic non-totalistic rules, the table is indexed by the 3x3
+  pattern of live cells rather than a count. Each column of three cells
+  is encoded with its cells at bits 0, 3 and 6, so the pattern for a 
+  cell is the codes of its own column and the two either side, shifted
+  by 1, 0, and 2 bits respectively and ORed together.
+
+  For Larger than Life rules, the neighbourhood is a box of side 
+  2R + 1. Rather than adding up (2R + 1)^2 cells for each cell, we keep
+  a running count of each column's live cells over the 2R + 1 rows
+  around the current row, which is updated by adding one row and
+  removing another as we move down, then get each cell's count from
+  prefix sums of those column counts along the row. So the cost per
+  cell does not depend on the radius.
+
+  The grid is stored with a border (halo) of extra cells around it, 
+  as wide as the radius of the neighbourhood. Before each generation,
+  the halo is filled according to the topology -- copies of the cells
+  at the opposite edge for a torus, say, or dead cells for a plane. 
+  The update functions can then treat every cell the same way, without
+  any tests for being at an edge. 
+
+  The topologies are:
+
+  torus -- the left and right edges are joined, as are the top and 
+    bottom (the default)
+  plane -- cells beyond the edges are permanently dead
+  klein -- a Klein bottle: as a torus, but the top and bottom edges are
+    joined with a left-right reflection
+  cross -- a cross-surface (real projective plane): both pairs of edges 
+    are joined with a reflection
+  unbounded -- the universe has no edges
+
+  An unbounded universe is stored as a TileMap of square tiles, which 
+  are created when cells near them might come to life, and freed when
+  they and their neighbours are all dead. To update a tile, it is 
+  copied into a padded buffer along with a halo from its neighbours,
+  so the same update functions are used as for a bounded grid. The 
+  width and height are then those of a viewport onto the universe,
+  which can be made to follow the live cells around.
+
+  A large bounded grid does not fit in the CPU cache, so each 
+  generation has to stream the whole grid in from memory and back 
+  out again. When several generations are to be computed at once 
+  (life_step_n), such grids are instead processed in blocks, each 
+  advanced by up to LIFE_BLOCK_DEPTH generations before moving on to 
+  the next: temporal blocking. To advance a block by k generations, 
+  we need its cells plus a margin of k * R cells all round; each 
+  generation, the margin that can be computed correctly shrinks by R.
+  So the halo around the whole grid is made k * R cells wide. The 
+  cells in the margins are computed more than once, by neighbouring
+  blocks, but the work stays in the cache. This is only done where
+  the cells in the halo evolve exactly as the cells they are copies
+  of would -- for a torus (with an even height, if the grid is 
+  hexagonal) and for a plane, where any cells born in the halo are
+  cleared after each generation.
+
 ============================================================================*/
 
 #define _GNU_SOURCE
@@ -17,34 +89,163 @@
 #include <stdarg.h>
 #include <errno.h>
 #include <unistd.h>
+#include <strings.h>
+#include <limits.h>
 #include "defs.h" 
 #include "log.h" 
+#include "rule.h" 
+#include "tilemap.h" 
 #include "life.h" 
-
+#include "trace.h" 
 
 struct _Life
   {
   int w; // Width
   int h; // Height
-  char *B; // Birth rule
-  char *S; // Survival rule
-  BYTE *cells;
+  int halo; // Width of the border around the grid
+  int pw; // Padded width, w + 2 * halo; this is the row stride
+  int ph; // Padded height
+  Rule *rule;
+  LifeTopology topology;
+  BYTE *cells; // pw * ph cells, including the halo
+  BYTE *new_cells; // Scratch space for life_update, the same size
+  BYTE *colsum; // Per-column live counts for one row, pw entries
+  BYTE *midsum; // Live flags for the current row, pw entries
+  int *ltl_colsum; // Larger than Life column counts, pw entries
+  int *ltl_prefix; // Larger than Life prefix sums, pw + 1 entries
+  int population; // Live cells after the last update or seed
+  int changed; // Cells changed by the last generation, or seed
+  int block_depth; // Generations per block, or 0 if not blocking
+  BYTE *block_in; // Two buffers for a block plus its margins,
+  BYTE *block_out; //   block_pw cells square
+  int block_pw;
+  TileMap *tiles; // For an unbounded universe; otherwise NULL
+  int view_x; // Universe coordinates of the top-left of the viewport
+  int view_y; //   (unbounded universe only)
+  BOOL follow; // Keep the viewport centred on the live cells
   }; 
 
+// Grids with more cells than this are stepped in blocks; see the notes
+//   above. Roughly the size of the L2 cache of small ARM CPUs
+#define LIFE_BLOCKING_MIN_CELLS (256 * 1024)
+// Blocks have this many cells on a side, not including margins
+#define LIFE_BLOCK_SIZE 256 
+// The most generations to advance a block in one go
+#define LIFE_BLOCK_DEPTH 8
+
+// The cell at column x and row y, where (0,0) is the top-left cell of 
+//   the grid proper, not the halo 
+#define LIFE_CELL(self,x,y) \
+  ((self)->cells [((y) + (self)->halo) * (self)->pw + (x) + (self)->halo])
+
+static const char *life_topology_names[] = 
+  { "torus", "plane", "klein", "cross", "unbounded", NULL };
+
+/*==========================================================================
+  life_parse_topology
+
+  Returns FALSE if the name is not recognized
+*==========================================================================*/
+BOOL life_parse_topology (const char *name, LifeTopology *topology)
+  {
+  for (int i = 0; life_topology_names[i]; i++)
+    {
+    if (strcasecmp (name, life_topology_names[i]) == 0)
+      {
+      *topology = (LifeTopology)i;
+      return TRUE;
+      }
+    }
+  if (strcasecmp (name, "infinite") == 0)
+    {
+    *topology = LIFE_TOPOLOGY_UNBOUNDED;
+    return TRUE;
+    }
+  return FALSE;
+  }
+
+/*==========================================================================
+
+  life_init_blocking
+
+  Decide whether a bounded grid is to be stepped in blocks (see the
+  notes at the top of this file) and, if so, how many generations at
+  a time. The margins are limited to a quarter of the block size, or
+  the redundant work in them would outweigh the benefit. The halo
+  is widened to fit the margins.
+
+*==========================================================================*/
+static void life_init_blocking (Life *self)
+  {
+  int r = self->halo;
+  int depth = LIFE_BLOCK_DEPTH;
+  if (depth * r > LIFE_BLOCK_SIZE / 4) depth = LIFE_BLOCK_SIZE / (4 * r);
+
+  if (depth < 2) return;
+  if (self->w * self->h <= LIFE_BLOCKING_MIN_CELLS) return;
+  if (self->w < 2 * depth * r || self->h < 2 * depth * r) return;
+  if (self->topology != LIFE_TOPOLOGY_TORUS 
+      && self->topology != LIFE_TOPOLOGY_PLANE) return;
+  if (rule_get_family (self->rule) == RULE_FAMILY_HEX && (self->h & 1)) 
+    return;
+
+  self->block_depth = depth;
+  self->halo = depth * r;
+  self->block_pw = LIFE_BLOCK_SIZE + 2 * self->halo;
+  int size = self->block_pw * self->block_pw * sizeof (BYTE);
+  self->block_in = malloc (size);
+  self->block_out = malloc (size);
+  log_debug ("Stepping in blocks of %d generations", depth);
+  }
 
 /*==========================================================================
   life_create
 *==========================================================================*/
-Life *life_create (int w, int h, const char *B, const char *S)
+Life *life_create (int w, int h, const Rule *rule, LifeTopology topology)
   {
   LOG_IN
   Life *self = malloc (sizeof (Life));
   self->w = w;
   self->h = h;
-  self->cells = malloc (w * h * sizeof (BYTE));
-  memset (self->cells, 0, w * h * sizeof (BYTE)); 
-  self->B = strdup (B);
-  self->S = strdup (S);
+  self->halo = rule_get_radius (rule);
+  self->topology = topology;
+  self->tiles = NULL;
+  self->view_x = 0;
+  self->view_y = 0;
+  self->follow = FALSE;
+  self->rule = rule_clone (rule);
+  self->block_depth = 0;
+  self->block_in = NULL;
+  self->block_out = NULL;
+  if (topology == LIFE_TOPOLOGY_UNBOUNDED)
+    {
+    // The cell buffers hold just one padded tile at a time
+    self->tiles = tilemap_create();
+    self->pw = TILEMAP_TILE_SIZE + 2 * self->halo;
+    self->ph = self->pw; 
+    }
+  else
+    {
+    life_init_blocking (self);
+    self->pw = w + 2 * self->halo;
+    self->ph = h + 2 * self->halo;
+    }
+  int size = self->pw * self->ph * sizeof (BYTE);
+  self->cells = malloc (size);
+  memset (self->cells, 0, size); 
+  self->new_cells = malloc (size);
+  memset (self->new_cells, 0, size); 
+  self->colsum = malloc (self->pw * sizeof (BYTE));
+  self->midsum = malloc (self->pw * sizeof (BYTE));
+  self->ltl_colsum = NULL;
+  self->ltl_prefix = NULL;
+  if (rule_get_family (rule) == RULE_FAMILY_LTL)
+    {
+    self->ltl_colsum = malloc (self->pw * sizeof (int));
+    self->ltl_prefix = malloc ((self->pw + 1) * sizeof (int));
+    }
+  self->population = 0;
+  self->changed = 0;
   LOG_OUT
   return self;
   }
@@ -53,12 +254,115 @@ Life *life_create (int w, int h, const char *B, const char *S)
 
   life_set_cell
 
-  set a specific cell alive or dead  
+  set a specific cell to a specific state -- see life_get_state. The
+  coordinates are relative to the viewport in an unbounded universe.
+  The caller must ensure that the cell is within the grid, and the
+  state is valid for the rule
 
 *==========================================================================*/
-void life_set_cell (Life *self, int x, int y, BOOL alive)
+void life_set_cell (Life *self, int x, int y, int state)
   {
-  self->cells [y *self->w + x] = alive;
+  BYTE *cell;
+  if (self->tiles)
+    {
+    x += self->view_x;
+    y += self->view_y;
+    Tile *tile = tilemap_get (self->tiles, TILEMAP_TILE_OF (x), 
+      TILEMAP_TILE_OF (y));
+    if (tile == NULL)
+      {
+      if (state == 0) return;
+      tile = tilemap_get_or_create (self->tiles, TILEMAP_TILE_OF (x), 
+        TILEMAP_TILE_OF (y));
+      }
+    cell = &tile->cells [TILEMAP_OFFSET_OF (y) * TILEMAP_TILE_SIZE 
+      + TILEMAP_OFFSET_OF (x)];
+    tile->occupied += (state != 0) - (*cell != 0);
+    }
+  else
+    cell = &LIFE_CELL (self, x, y);
+  self->population += (state == 1) - (*cell == 1);
+  *cell = state;
+  }
+
+
+/*==========================================================================
+
+  life_clear
+
+  Set all the cells dead
+
+*==========================================================================*/
+void life_clear (Life *self)
+  {
+  LOG_IN
+  if (self->tiles) 
+    tilemap_clear (self->tiles);
+  else
+    memset (self->cells, 0, self->pw * self->ph);
+  self->population = 0;
+  self->changed = self->w * self->h;
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+
+  life_set_rule
+
+  Change the rule, keeping the cells. Cells in dying states that the 
+  new rule does not have become dead. A different rule may need a 
+  different halo, and different working space, so this builds a 
+  complete new Life, moves the cells into it, and then swaps it with
+  this one
+
+*==========================================================================*/
+void life_set_rule (Life *self, const Rule *rule)
+  {
+  LOG_IN
+  Life *other = life_create (self->w, self->h, rule, self->topology);
+  int states = rule_get_states (rule);
+  int population = 0;
+  if (self->tiles)
+    {
+    TileMap *temp = other->tiles;
+    other->tiles = self->tiles;
+    self->tiles = temp;
+    int size = TILEMAP_TILE_SIZE * TILEMAP_TILE_SIZE;
+    for (int i = 0; i < tilemap_get_count (other->tiles); i++)
+      {
+      Tile *tile = tilemap_get_tile (other->tiles, i);
+      tile->occupied = 0;
+      for (int j = 0; j < size; j++)
+        {
+        if (tile->cells[j] >= states) tile->cells[j] = 0;
+        tile->occupied += (tile->cells[j] != 0);
+        population += (tile->cells[j] == 1);
+        }
+      }
+    }
+  else
+    {
+    for (int y = 0; y < self->h; y++)
+      for (int x = 0; x < self->w; x++)
+        {
+        BYTE state = LIFE_CELL (self, x, y);
+        if (state >= states) state = 0;
+        LIFE_CELL (other, x, y) = state;
+        population += (state == 1);
+        }
+    }
+  other->population = population;
+  other->changed = self->changed;
+  other->view_x = self->view_x;
+  other->view_y = self->view_y;
+  other->follow = self->follow;
+
+  Life temp = *self;
+  *self = *other;
+  *other = temp;
+  life_destroy (other);
+  LOG_OUT
   }
 
 
@@ -72,24 +376,25 @@ void life_set_cell (Life *self, int x, int y, BOOL alive)
 *==========================================================================*/
 void life_seed (Life *self, int percent)
   {
-  for (int i = 0; i < self->w * self->h; i++)
-    self->cells[i] = (rand() * 100.0 / RAND_MAX < percent ? 8 : 0);
-  //  self->cells[i] = 0;
-  
-/*
-  life_set_cell (self, 10, 10, 1);
-  life_set_cell (self, 11, 10, 1);
-  life_set_cell (self, 8, 9, 1);
-  life_set_cell (self, 9, 9, 1);
-  life_set_cell (self, 11, 9, 1);
-  life_set_cell (self, 12, 9, 1);
-  life_set_cell (self, 11, 8, 1);
-  life_set_cell (self, 10, 8, 1);
-  life_set_cell (self, 9, 8, 1);
-  life_set_cell (self, 8, 8, 1);
-  life_set_cell (self, 9, 7, 1);
-  life_set_cell (self, 10, 7, 1);
- */ 
+  TRACE_BEGIN (t);
+  int population = 0;
+  if (self->tiles) 
+    tilemap_clear (self->tiles);
+  for (int y = 0; y < self->h; y++)
+    {
+    for (int x = 0; x < self->w; x++)
+      {
+      BYTE state = (rand() * 100.0 / RAND_MAX < percent ? 1 : 0);
+      if (self->tiles)
+        life_set_cell (self, x, y, state);
+      else
+        LIFE_CELL (self, x, y) = state;
+      population += state;
+      }
+    }
+  self->population = population;
+  self->changed = self->w * self->h;
+  TRACE_END (t, "life", "seed");
   }
 
 
@@ -102,8 +407,15 @@ void  life_destroy (Life *self)
   if (self)
     {
     if (self->cells) free (self->cells);
-    if (self->B) free (self->B);
-    if (self->S) free (self->S);
+    if (self->new_cells) free (self->new_cells);
+    if (self->colsum) free (self->colsum);
+    if (self->midsum) free (self->midsum);
+    if (self->ltl_colsum) free (self->ltl_colsum);
+    if (self->ltl_prefix) free (self->ltl_prefix);
+    if (self->rule) rule_destroy (self->rule);
+    if (self->tiles) tilemap_destroy (self->tiles);
+    if (self->block_in) free (self->block_in);
+    if (self->block_out) free (self->block_out);
     free (self);
     }
   LOG_OUT
@@ -133,141 +445,925 @@ int life_get_height (const Life *self)
   return ret;
   }
 
+/*==========================================================================
+  life_get_states
+
+  The number of distinct cell states -- 2 except for Generations rules
+*==========================================================================*/
+int life_get_states (const Life *self)
+  {
+  return rule_get_states (self->rule);
+  }
+
+/*==========================================================================
+  life_get_rule
+*==========================================================================*/
+const Rule *life_get_rule (const Life *self)
+  {
+  return self->rule;
+  }
+
+/*==========================================================================
+  life_get_topology
+*==========================================================================*/
+LifeTopology life_get_topology (const Life *self)
+  {
+  return self->topology;
+  }
+
+/*==========================================================================
+  life_get_population
+
+  The number of live cells, as of the last update or seed
+*==========================================================================*/
+int life_get_population (const Life *self)
+  {
+  return self->population;
+  }
+
+/*==========================================================================
+  life_get_changed
+
+  The number of cells that changed state in the last generation 
+  computed by life_step_n or, after a seed, the number of cells in 
+  the grid. This is a measure of how lively the pattern is, not of how
+  many cells differ from the last time they were drawn -- a blinker 
+  stepped by two generations counts four changes, not none
+*==========================================================================*/
+int life_get_changed (const Life *self)
+  {
+  return self->changed;
+  }
+
 /*==========================================================================
   life_get_state
 
-  In most case, the state can be taken to be a boolean value, indicating
-  whether the cell is alive or dead. However, the update() method 
-  actually sets the state to a number between 0 and 8, indicating the
-  number of live neighbours. This may be useful for display purposes,
-  although it does not affect the algorithm.
+  0 means dead, 1 alive and, with Generations rules, 2 upwards are
+  successive stages of dying. 
 
 *==========================================================================*/
 int  life_get_state (const Life *self, int col, int row)
   {
-  LOG_IN
-  BOOL state = self->cells [row * self->w + col];
-  LOG_OUT
-  return state;
+  if (self->tiles)
+    {
+    int x = col + self->view_x;
+    int y = row + self->view_y;
+    const Tile *tile = tilemap_get (self->tiles, TILEMAP_TILE_OF (x), 
+      TILEMAP_TILE_OF (y));
+    if (tile == NULL) return 0;
+    return tile->cells [TILEMAP_OFFSET_OF (y) * TILEMAP_TILE_SIZE 
+      + TILEMAP_OFFSET_OF (x)];
+    }
+  return LIFE_CELL (self, col, row);
   }
 
+/*==========================================================================
+  life_set_follow
+
+  With an unbounded universe, keep the viewport centred on the live
+  cells. This has no effect on a bounded grid
+*==========================================================================*/
+void life_set_follow (Life *self, BOOL follow)
+  {
+  self->follow = follow;
+  }
 
 /*==========================================================================
+  life_get_viewport
 
-  life_get_live_neighbours
+  The universe coordinates of the top-left corner of the viewport.
+  For a bounded grid, these are always zero
+*==========================================================================*/
+void life_get_viewport (const Life *self, int *x, int *y)
+  {
+  *x = self->view_x;
+  *y = self->view_y;
+  }
 
-  Get the number of live neighbouring cells -- a number between 0 and
-  8. The cell itself is not counted.
+/*==========================================================================
+  life_get_tile_count
 
+  The number of tiles allocated for an unbounded universe; zero for 
+  a bounded grid
 *==========================================================================*/
-int life_get_live_neighbours (const Life *self, int row, int col)
+int life_get_tile_count (const Life *self)
   {
-  LOG_IN
-  int ret = 0; 
-  int h = self->h;
-  int w = self->w;
-   
-  for (int r = row - 1; r <= row + 1; r++)
-    {
-    int _r = r;
-    if (_r >= h) _r = 0;
-    if (_r < 0) _r = h - 1;
-    for (int c = col - 1; c <= col + 1; c++)
+  return self->tiles ? tilemap_get_count (self->tiles) : 0;
+  }
+
+
+/*==========================================================================
+
+  life_fill_halo_torus
+
+  Each halo cell is a copy of the cell at the opposite edge. The side
+  columns are filled first, for the rows of the grid proper; then the
+  top and bottom rows are copied whole, which takes care of the 
+  corners.
+
+*==========================================================================*/
+static void life_fill_halo_torus (Life *self)
+  {
+  int w = self->w, h = self->h, r = self->halo, pw = self->pw;
+  for (int y = r; y < h + r; y++)
+    {
+    BYTE *row = self->cells + y * pw;
+    memcpy (row, row + w, r);
+    memcpy (row + w + r, row + r, r);
+    }
+  for (int k = 0; k < r; k++)
+    {
+    memcpy (self->cells + k * pw, self->cells + (h + k) * pw, pw);
+    memcpy (self->cells + (h + r + k) * pw, self->cells + (r + k) * pw, pw);
+    }
+  }
+
+
+/*==========================================================================
+
+  life_copy_row_reversed
+
+*==========================================================================*/
+static void life_copy_row_reversed (BYTE *to, const BYTE *from, int n)
+  {
+  for (int i = 0; i < n; i++)
+    to [i] = from [n - 1 - i];
+  }
+
+
+/*==========================================================================
+
+  life_fill_halo_klein
+
+  The side columns wrap as for a torus; the rows above the top edge
+  are copies of the rows at the bottom, reflected left-to-right, and
+  vice versa.
+
+*==========================================================================*/
+static void life_fill_halo_klein (Life *self)
+  {
+  int w = self->w, h = self->h, r = self->halo, pw = self->pw;
+  for (int y = r; y < h + r; y++)
+    {
+    BYTE *row = self->cells + y * pw;
+    memcpy (row, row + w, r);
+    memcpy (row + w + r, row + r, r);
+    }
+  for (int k = 0; k < r; k++)
+    {
+    life_copy_row_reversed (self->cells + k * pw, 
+      self->cells + (h + k) * pw, pw);
+    life_copy_row_reversed (self->cells + (h + r + k) * pw, 
+      self->cells + (r + k) * pw, pw);
+    }
+  }
+
+
+/*==========================================================================
+
+  life_fill_halo_cross
+
+  As for the Klein bottle, but the side columns are also reflected, 
+  top-to-bottom. The corners of the halo have no single natural 
+  interpretation on a cross-surface; they come out as copies from 
+  the diagonally-opposite corner of the grid.
+
+*==========================================================================*/
+static void life_fill_halo_cross (Life *self)
+  {
+  int w = self->w, h = self->h, r = self->halo, pw = self->pw;
+  for (int y = 0; y < h; y++)
+    {
+    BYTE *row = self->cells + (y + r) * pw;
+    const BYTE *mirror = self->cells + (h - 1 - y + r) * pw;
+    memcpy (row, mirror + w, r);
+    memcpy (row + w + r, mirror + r, r);
+    }
+  for (int k = 0; k < r; k++)
+    {
+    life_copy_row_reversed (self->cells + k * pw, 
+      self->cells + (h + k) * pw, pw);
+    life_copy_row_reversed (self->cells + (h + r + k) * pw, 
+      self->cells + (r + k) * pw, pw);
+    }
+  }
+
+
+/*==========================================================================
+
+  life_fill_halo
+
+  Fill the halo according to the topology. For a plane, the halo is
+  always dead, and nothing need be done -- the update functions never 
+  write into it. 
+
+*==========================================================================*/
+static void life_fill_halo (Life *self)
+  {
+  TRACE_BEGIN (t);
+  switch (self->topology)
+    {
+    case LIFE_TOPOLOGY_TORUS: life_fill_halo_torus (self); break;
+    case LIFE_TOPOLOGY_KLEIN: life_fill_halo_klein (self); break;
+    case LIFE_TOPOLOGY_CROSS: life_fill_halo_cross (self); break;
+    case LIFE_TOPOLOGY_PLANE: 
+    case LIFE_TOPOLOGY_UNBOUNDED: break;
+    }
+  TRACE_END (t, "life", "fill_halo");
+  }
+
+
+/*==========================================================================
+
+  life_update_row
+
+  Compute the new states of one row of cells. above, row, and below are
+  the current rows, and out is the row to write; all point to column 0,
+  and the input rows must have valid halo cells at columns -1 and w. 
+  colsum is scratch space of w + 2 entries.
+
+  We first count, for each column, the live cells in the three rows; 
+  then the neighbourhood count for a cell is the sum of the counts for
+  its column and the two either side. 
+
+  Returns the number of cells whose state changed; the number of live
+  and non-dead cells in the new row are added to *population and 
+  *occupied. 
+
+*==========================================================================*/
+static int life_update_row (const BYTE *above, const BYTE *row, 
+    const BYTE *below, BYTE *out, int w, BYTE *colsum, const BYTE *table, 
+    int stride, int *population, int *occupied)
+  {
+  for (int x = -1; x <= w; x++)
+    colsum [x + 1] = (above[x] == 1) + (row[x] == 1) + (below[x] == 1);
+
+  int changed = 0, pop = 0, occ = 0;
+  for (int x = 0; x < w; x++)
+    {
+    BYTE state = row [x];
+    int n = colsum [x] + colsum [x + 1] + colsum [x + 2];
+    BYTE new = table [state * stride + n];
+    out [x] = new;
+    changed += (new != state);
+    pop += (new == 1);
+    occ += (new != 0);
+    }
+
+  *population += pop;
+  *occupied += occ;
+  return changed;
+  }
+
+/*==========================================================================
+
+  life_update_row_vn
+
+  As life_update_row, but for the von Neumann neighbourhood. The count
+  is the column count (cell, above, below) plus the cells either side
+
+*==========================================================================*/
+static int life_update_row_vn (const BYTE *above, const BYTE *row, 
+    const BYTE *below, BYTE *out, int w, BYTE *colsum, 
+    const BYTE *table, int stride, int *population, int *occupied)
+  {
+  for (int x = 0; x < w; x++)
+    colsum [x] = (above[x] == 1) + (row[x] == 1) + (below[x] == 1);
+
+  int changed = 0, pop = 0, occ = 0;
+  for (int x = 0; x < w; x++)
+    {
+    BYTE state = row [x];
+    int n = colsum [x] + (row [x - 1] == 1) + (row [x + 1] == 1);
+    BYTE new = table [state * stride + n];
+    out [x] = new;
+    changed += (new != state);
+    pop += (new == 1);
+    occ += (new != 0);
+    }
+
+  *population += pop;
+  *occupied += occ;
+  return changed;
+  }
+
+/*==========================================================================
+
+  life_update_row_hex
+
+  As life_update_row, but for the hexagonal neighbourhood. colsum
+  holds the live counts of the rows above and below (not the current
+  row), and midsum the current row. For an even row, the neighbours
+  above and below are at x - 1 and x; for an odd row at x and x + 1,
+  which amounts to shifting colsum by one entry.
+
+*==========================================================================*/
+static int life_update_row_hex (const BYTE *above, const BYTE *row, 
+    const BYTE *below, BYTE *out, int w, BYTE *colsum, BYTE *midsum,
+    BOOL odd, const BYTE *table, int stride, int *population, 
+    int *occupied)
+  {
+  for (int x = -1; x <= w; x++)
+    {
+    colsum [x + 1] = (above[x] == 1) + (below[x] == 1);
+    midsum [x + 1] = (row[x] == 1);
+    }
+
+  const BYTE *v = odd ? colsum + 1 : colsum;
+  int changed = 0, pop = 0, occ = 0;
+  for (int x = 0; x < w; x++)
+    {
+    BYTE state = row [x];
+    int n = v [x] + v [x + 1] + midsum [x] + midsum [x + 1] + midsum [x + 2];
+    BYTE new = table [state * stride + n];
+    out [x] = new;
+    changed += (new != state);
+    pop += (new == 1);
+    occ += (new != 0);
+    }
+
+  *population += pop;
+  *occupied += occ;
+  return changed;
+  }
+
+/*==========================================================================
+
+  life_update_row_isotropic
+
+  As life_update_row, but for isotropic non-totalistic rules. colsum
+  holds 3-bit column codes rather than counts
+
+*==========================================================================*/
+static int life_update_row_isotropic (const BYTE *above, const BYTE *row, 
+    const BYTE *below, BYTE *out, int w, BYTE *colsum, const BYTE *table, 
+    int stride, int *population, int *occupied)
+  {
+  for (int x = -1; x <= w; x++)
+    colsum [x + 1] = (above[x] == 1) | (row[x] == 1) << 3 
+      | (below[x] == 1) << 6;
+
+  int changed = 0, pop = 0, occ = 0;
+  for (int x = 0; x < w; x++)
+    {
+    BYTE state = row [x];
+    int n = colsum [x] | colsum [x + 1] << 1 | colsum [x + 2] << 2;
+    BYTE new = table [state * stride + n];
+    out [x] = new;
+    changed += (new != state);
+    pop += (new == 1);
+    occ += (new != 0);
+    }
+
+  *population += pop;
+  *occupied += occ;
+  return changed;
+  }
+
+/*==========================================================================
+
+  life_update_ltl
+
+  Update a block of cells for a Larger than Life rule. See the notes
+  at the top of this file. in and out point to cell (0,0) of the block,
+  and rows are pw cells apart; the input must have a valid halo of
+  width r all round.
+
+*==========================================================================*/
+static int life_update_ltl (Life *self, const BYTE *in, BYTE *out, 
+     int pw, int w, int h, int *population, int *occupied)
+  {
+  int r = rule_get_radius (self->rule);
+  const BYTE *table = rule_get_table (self->rule);
+  int stride = rule_get_table_stride (self->rule);
+  int *colsum = self->ltl_colsum;
+  int *prefix = self->ltl_prefix;
+  int cols = w + 2 * r; // Columns including the halo
+  int changed = 0, pop = 0, occ = 0;
+
+  // Column counts for the rows -r..r around row 0
+  memset (colsum, 0, cols * sizeof (int));
+  for (int dy = -r; dy <= r; dy++)
+    {
+    const BYTE *src = in + dy * pw - r;
+    for (int x = 0; x < cols; x++)
+      colsum [x] += (src[x] == 1);
+    }
+
+  for (int row = 0; row < h; row++)
+    {
+    // Prefix sums of the column counts along the row, starting at
+    //   column -r
+    prefix [0] = 0;
+    for (int x = 0; x < cols; x++)
+      prefix [x + 1] = prefix [x] + colsum [x];
+
+    const BYTE *src = in + row * pw;
+    BYTE *dest = out + row * pw;
+    for (int x = 0; x < w; x++)
       {
-      int _c = c;
-      if (_c >= w) _c = 0;
-      if (_c < 0) _c = w - 1;
-      if (_c >= 0 && _c < w && _r >= 0 && _r < h 
-           && (!(_r == row && _c == col)))
+      BYTE state = src [x];
+      int n = prefix [x + 2 * r + 1] - prefix [x];
+      BYTE new = table [state * stride + n];
+      dest [x] = new;
+      changed += (new != state);
+      pop += (new == 1);
+      occ += (new != 0);
+      }
+
+    // Slide the window of rows down by one
+    if (row < h - 1)
+      {
+      const BYTE *leaving = in + (row - r) * pw - r;
+      const BYTE *entering = in + (row + r + 1) * pw - r;
+      for (int x = 0; x < cols; x++)
+        colsum [x] += (entering[x] == 1) - (leaving[x] == 1);
+      }
+    }
+
+  *population += pop;
+  *occupied += occ;
+  return changed;
+  }
+
+/*==========================================================================
+
+  life_update_block
+
+  Update a block of w x h cells, reading from in and writing to out.
+  Both point to the top-left cell of the block, and rows are pw cells
+  apart. The input must have a valid halo, as wide as the rule's
+  radius, all round the block. y0 is the row number of the top of the 
+  block in the grid, which matters only for the parity of rows in a 
+  hexagonal grid. Returns the number of cells that changed state.
+
+*==========================================================================*/
+static int life_update_block (Life *self, const BYTE *in, BYTE *out, 
+     int pw, int w, int h, int y0, int *population, int *occupied)
+  {
+  const BYTE *table = rule_get_table (self->rule);
+  int stride = rule_get_table_stride (self->rule);
+  int changed = 0;
+
+  switch (rule_get_family (self->rule))
+    {
+    case RULE_FAMILY_LTL:
+      changed = life_update_ltl (self, in, out, pw, w, h, 
+        population, occupied);
+      break;
+    case RULE_FAMILY_HEX:
+      for (int row = 0; row < h; row++)
+        {
+        const BYTE *src = in + row * pw;
+        changed += life_update_row_hex (src - pw, src, src + pw, 
+          out + row * pw, w, self->colsum, self->midsum, (y0 + row) & 1, 
+          table, stride, population, occupied);
+        }
+      break;
+    case RULE_FAMILY_VON_NEUMANN:
+      for (int row = 0; row < h; row++)
+        {
+        const BYTE *src = in + row * pw;
+        changed += life_update_row_vn (src - pw, src, src + pw, 
+          out + row * pw, w, self->colsum, table, stride, 
+          population, occupied);
+        }
+      break;
+    case RULE_FAMILY_ISOTROPIC:
+      for (int row = 0; row < h; row++)
         {
-        if (self->cells [_r * self->w + _c]) ret++;
+        const BYTE *src = in + row * pw;
+        changed += life_update_row_isotropic (src - pw, src, src + pw, 
+          out + row * pw, w, self->colsum, table, stride, 
+          population, occupied);
+        }
+      break;
+    default:
+      for (int row = 0; row < h; row++)
+        {
+        const BYTE *src = in + row * pw;
+        changed += life_update_row (src - pw, src, src + pw, 
+          out + row * pw, w, self->colsum, table, stride, 
+          population, occupied);
+        }
+    }
+  return changed;
+  }
+
+/*==========================================================================
+
+  life_gather_tile
+
+  Copy a tile, with a halo from its neighbours, into the padded buffer
+  self->cells. Missing neighbours are all dead.
+
+*==========================================================================*/
+static void life_gather_tile (Life *self, const Tile *tile)
+  {
+  int r = self->halo, pw = self->pw;
+  const int T = TILEMAP_TILE_SIZE;
+  for (int dy = -1; dy <= 1; dy++)
+    {
+    // Rows y0..y0+rows-1 of the buffer, relative to the tile, come from 
+    //   rows sy.. of the tile at dy
+    int y0 = dy < 0 ? -r : dy * T;
+    int rows = dy == 0 ? T : r;
+    int sy = dy < 0 ? T - r : 0;
+    for (int dx = -1; dx <= 1; dx++)
+      {
+      int x0 = dx < 0 ? -r : dx * T;
+      int cols = dx == 0 ? T : r;
+      int sx = dx < 0 ? T - r : 0;
+      const Tile *from = (dx == 0 && dy == 0) ? tile
+        : tilemap_get (self->tiles, tile->tx + dx, tile->ty + dy);
+      for (int y = 0; y < rows; y++)
+        {
+        BYTE *dest = self->cells + (y0 + y + r) * pw + x0 + r;
+        if (from)
+          memcpy (dest, from->cells + (sy + y) * T + sx, cols);
+        else
+          memset (dest, 0, cols);
         }
       }
-    } 
- 
-  LOG_OUT;
-  return ret;
+    }
+  }
+
+/*==========================================================================
+
+  life_has_occupied_neighbour
+
+*==========================================================================*/
+static BOOL life_has_occupied_neighbour (const Life *self, const Tile *tile)
+  {
+  for (int dy = -1; dy <= 1; dy++)
+    for (int dx = -1; dx <= 1; dx++)
+      {
+      const Tile *n = tilemap_get (self->tiles, tile->tx + dx, 
+        tile->ty + dy);
+      if (n && n->occupied) return TRUE;
+      }
+  return FALSE;
   }
 
 /*==========================================================================
 
-  life_new_cell_state
+  life_tile_row_occupied, life_tile_column_occupied
 
-  Given that a current cell is alive or dead, work out whether it
-  should change to being alive or dead, given how many neighbouring
-  cells are alive
+  Whether any cell in row y, or column x, of a tile is not dead
 
 *==========================================================================*/
-BOOL life_new_cell_state (const Life *self, BOOL alive, int neighbours,
-    const char *B, const char *S)
+static BOOL life_tile_row_occupied (const Tile *tile, int y)
   {
-  LOG_IN
-  BOOL new = FALSE;
+  const int T = TILEMAP_TILE_SIZE;
+  const BYTE *row = tile->cells + y * T;
+  for (int x = 0; x < T; x++)
+    if (row[x]) return TRUE;
+  return FALSE;
+  }
 
-  if (strchr (B, neighbours + '0')) new = TRUE;
-  else if (alive && strchr (S, neighbours + '0')) new = TRUE;
+static BOOL life_tile_column_occupied (const Tile *tile, int x)
+  {
+  const int T = TILEMAP_TILE_SIZE;
+  for (int y = 0; y < T; y++)
+    if (tile->cells[y * T + x]) return TRUE;
+  return FALSE;
+  }
 
-  LOG_OUT
-  return new;
+/*==========================================================================
+
+  life_follow
+
+  Centre the viewport on the bounding box of the non-dead cells. For
+  a hexagonal grid, the top row must stay even, or the drawing would 
+  have the rows offset the wrong way. Only the occupied tiles at the 
+  edges of the box of occupied tiles can hold its edges, so only 
+  those are looked at, and each of them only from the outside in, 
+  until an occupied row or column is found.
+
+*==========================================================================*/
+static void life_follow (Life *self)
+  {
+  const int T = TILEMAP_TILE_SIZE;
+  int min_tx = INT_MAX, min_ty = INT_MAX, max_tx = INT_MIN, max_ty = INT_MIN;
+  int n = tilemap_get_count (self->tiles);
+  for (int i = 0; i < n; i++)
+    {
+    const Tile *tile = tilemap_get_tile (self->tiles, i);
+    if (tile->occupied == 0) continue;
+    if (tile->tx < min_tx) min_tx = tile->tx;
+    if (tile->tx > max_tx) max_tx = tile->tx;
+    if (tile->ty < min_ty) min_ty = tile->ty;
+    if (tile->ty > max_ty) max_ty = tile->ty;
+    }
+  if (min_tx > max_tx) return; // Nothing alive
+
+  // Offsets of the extreme cells within the edge tiles
+  int min_x = T - 1, min_y = T - 1, max_x = 0, max_y = 0;
+  for (int i = 0; i < n; i++)
+    {
+    const Tile *tile = tilemap_get_tile (self->tiles, i);
+    if (tile->occupied == 0) continue;
+    // Each search stops at the extreme found so far, since an
+    //   occupied tile must have an occupied row and column
+    int x, y;
+    if (tile->tx == min_tx)
+      {
+      for (x = 0; x < min_x && !life_tile_column_occupied (tile, x); x++);
+      min_x = x;
+      }
+    if (tile->tx == max_tx)
+      {
+      for (x = T - 1; x > max_x && !life_tile_column_occupied (tile, x); x--);
+      max_x = x;
+      }
+    if (tile->ty == min_ty)
+      {
+      for (y = 0; y < min_y && !life_tile_row_occupied (tile, y); y++);
+      min_y = y;
+      }
+    if (tile->ty == max_ty)
+      {
+      for (y = T - 1; y > max_y && !life_tile_row_occupied (tile, y); y--);
+      max_y = y;
+      }
+    }
+  min_x += min_tx * T;
+  max_x += max_tx * T;
+  min_y += min_ty * T;
+  max_y += max_ty * T;
+
+  self->view_x = min_x + (max_x - min_x) / 2 - self->w / 2;
+  self->view_y = min_y + (max_y - min_y) / 2 - self->h / 2;
+  if (rule_get_family (self->rule) == RULE_FAMILY_HEX)
+    self->view_y &= ~1;
   }
 
 /*==========================================================================
 
-  life_update
+  life_update_unbounded
 
-  Update the entire grid to new cell states, based on existing
-  cell states.
+  Update every tile of an unbounded universe. First, make sure that
+  every tile next to a non-empty tile exists, as cells might be born
+  in it. Then update each tile, via the padded buffers, writing into
+  its new_cells. Only when all the tiles are done can new_cells be
+  swapped with cells, as the updates read the neighbouring tiles. 
+  Finally, free the tiles that are empty and have no non-empty 
+  neighbours. Returns the number of cells that changed.
 
 *==========================================================================*/
-BOOL life_update (Life *self)
+static int life_update_unbounded (Life *self, int *population, 
+     int *occupied)
   {
-  LOG_IN
-  BOOL ret = TRUE;
-  BOOL at_least_one = FALSE;
-  char *B = self->B; 
-  char *S = self->S; 
-
-  
-  // Note -- we must write the results int a new array,
-  //  and then copy it to self->cells. Otherwise, the
-  //  calculation is biased because of the scan
-  //  direction
-  BYTE *new_cells = malloc (self->w * self->h * sizeof (BOOL));
-  for (int row = 0; row < self->h; row++)
-    {
-    int stride = row * self->w;
-    for (int col = 0; col < self->w; col++)
+  const int T = TILEMAP_TILE_SIZE;
+  int origin = self->halo * self->pw + self->halo;
+  int changed = 0;
+
+  int n = tilemap_get_count (self->tiles);
+  for (int i = 0; i < n; i++)
+    {
+    Tile *tile = tilemap_get_tile (self->tiles, i);
+    if (tile->occupied == 0) continue;
+    int tx = tile->tx, ty = tile->ty; // tile might move in the array
+    for (int dy = -1; dy <= 1; dy++)
+      for (int dx = -1; dx <= 1; dx++)
+        tilemap_get_or_create (self->tiles, tx + dx, ty + dy);
+    }
+
+  n = tilemap_get_count (self->tiles);
+  for (int i = 0; i < n; i++)
+    {
+    Tile *tile = tilemap_get_tile (self->tiles, i);
+    int tile_occupied = 0;
+    life_gather_tile (self, tile);
+    changed += life_update_block (self, self->cells + origin, 
+      self->new_cells + origin, self->pw, T, T, 0, population, 
+      &tile_occupied);
+    for (int y = 0; y < T; y++)
+      memcpy (tile->new_cells + y * T, 
+        self->new_cells + origin + y * self->pw, T); 
+    tile->occupied = tile_occupied;
+    *occupied += tile_occupied;
+    }
+
+  for (int i = 0; i < n; i++)
+    {
+    Tile *tile = tilemap_get_tile (self->tiles, i);
+    BYTE *temp = tile->cells;
+    tile->cells = tile->new_cells;
+    tile->new_cells = temp;
+    }
+
+  for (int i = n - 1; i >= 0; i--)
+    {
+    Tile *tile = tilemap_get_tile (self->tiles, i);
+    if (tile->occupied == 0 && !life_has_occupied_neighbour (self, tile))
+      tilemap_remove (self->tiles, tile);
+    }
+
+  if (self->follow)
+    life_follow (self);
+
+  return changed;
+  }
+
+/*==========================================================================
+
+  life_step
+
+  Advance one generation. Sets *changed to the number of cells that 
+  changed state, and *occupied to the number that are not dead.
+
+*==========================================================================*/
+static void life_step (Life *self, int *changed, int *occupied)
+  {
+  TRACE_BEGIN (t);
+  int population = 0;
+  *occupied = 0;
+  if (self->tiles)
+    *changed = life_update_unbounded (self, &population, occupied);
+  else
+    {
+    int origin = self->halo * self->pw + self->halo;
+    life_fill_halo (self);
+
+    // Note -- we must write the results int a new array,
+    //  and then swap it with self->cells. Otherwise, the
+    //  calculation is biased because of the scan
+    //  direction
+    *changed = life_update_block (self, self->cells + origin, 
+      self->new_cells + origin, self->pw, self->w, self->h, 0, 
+      &population, occupied);
+
+    BYTE *temp = self->cells;
+    self->cells = self->new_cells;
+    self->new_cells = temp;
+    }
+  self->population = population;
+  TRACE_END (t, "life", "step");
+  }
+
+/*==========================================================================
+
+  life_clear_outside
+
+  For a plane, clear any cells of a block buffer that lie outside the
+  grid. x0, y0 are the grid coordinates of the buffer's top-left cell
+
+*==========================================================================*/
+static void life_clear_outside (const Life *self, BYTE *buff, int pw, 
+     int bw, int bh, int x0, int y0)
+  {
+  int left = x0 < 0 ? -x0 : 0;
+  int right = x0 + bw > self->w ? x0 + bw - self->w : 0;
+  for (int y = 0; y < bh; y++)
+    {
+    BYTE *row = buff + y * pw;
+    if (y0 + y < 0 || y0 + y >= self->h)
+      memset (row, 0, bw);
+    else
+      {
+      memset (row, 0, left);
+      memset (row + bw - right, 0, right);
+      }
+    }
+  }
+
+/*==========================================================================
+
+  life_step_blocked
+
+  Advance k generations, k no more than block_depth, one block at a
+  time. See the notes at the top of this file. Sets *changed and 
+  *occupied as life_step does, but for the last generation only.
+
+*==========================================================================*/
+static void life_step_blocked (Life *self, int k, int *changed, 
+     int *occupied)
+  {
+  int r = rule_get_radius (self->rule);
+  int margin = k * r;
+  int pw = self->block_pw;
+  TRACE_BEGIN (t);
+  int population = 0;
+  *changed = 0;
+  *occupied = 0;
+
+  life_fill_halo (self);
+
+  for (int by = 0; by < self->h; by += LIFE_BLOCK_SIZE)
+    {
+    int bh = self->h - by < LIFE_BLOCK_SIZE ? self->h - by : LIFE_BLOCK_SIZE;
+    for (int bx = 0; bx < self->w; bx += LIFE_BLOCK_SIZE)
       {
-      int n = life_get_live_neighbours (self, row, col);
-      BOOL current = (self->cells [stride + col] != 0);
-      BOOL new = life_new_cell_state (self, current, n, B, S); 
-      if (new)
+      int bw = self->w - bx < LIFE_BLOCK_SIZE 
+        ? self->w - bx : LIFE_BLOCK_SIZE;
+
+      // Copy in the block and its margins
+      int cols = bw + 2 * margin, rows = bh + 2 * margin;
+      for (int y = 0; y < rows; y++)
+        memcpy (self->block_in + y * pw, 
+          &LIFE_CELL (self, bx - margin, by - margin + y), cols);
+
+      // At generation g, compute the cells more than g * r from the 
+      //   edge of the buffer; in the last generation, that is just the
+      //   block itself
+      for (int g = 1; g <= k; g++)
         {
-        new_cells [stride + col] = n;
-        at_least_one = TRUE;
+        int inset = g * r;
+        int offset = inset * pw + inset;
+        int dummy_pop = 0, dummy_occ = 0;
+        BOOL last = (g == k);
+        int n = life_update_block (self, self->block_in + offset, 
+          self->block_out + offset, pw, cols - 2 * inset, 
+          rows - 2 * inset, by - margin + inset, 
+          last ? &population : &dummy_pop, 
+          last ? occupied : &dummy_occ);
+        if (last) 
+          *changed += n;
+        else if (self->topology == LIFE_TOPOLOGY_PLANE)
+          life_clear_outside (self, self->block_out + offset, pw, 
+            cols - 2 * inset, rows - 2 * inset, bx - margin + inset, 
+            by - margin + inset);
+        BYTE *temp = self->block_in;
+        self->block_in = self->block_out;
+        self->block_out = temp;
         }
-      else
-        new_cells [stride + col] = 0;
+
+      // The result is now in block_in
+      for (int y = 0; y < bh; y++)
+        memcpy (self->new_cells + (by + y + self->halo) * self->pw 
+          + bx + self->halo, self->block_in + (margin + y) * pw + margin, 
+          bw);
       }
     }
 
-  if (memcmp (self->cells, new_cells, 
-       self->w * self->h * sizeof (BYTE)) == 0) 
+  BYTE *temp = self->cells;
+  self->cells = self->new_cells;
+  self->new_cells = temp;
+  self->population = population;
+  TRACE_END (t, "life", "step_blocked");
+  }
+
+/*==========================================================================
+
+  life_step_n
+
+  Advance n generations, without anything being drawn in between. 
+  Returns FALSE if the pattern is stable -- the last generation 
+  changed nothing, or everything is dead. Either way, all further 
+  generations would be the same, so if that happens before the n'th 
+  generation, we stop there: the result is the same as if all n had 
+  been computed. When stepping in blocks, this is checked only at 
+  the end of each batch of generations, which comes to the same 
+  thing.
+
+*==========================================================================*/
+BOOL life_step_n (Life *self, int n)
+  {
+  LOG_IN
+  BOOL ret = TRUE;
+  while (n > 0 && ret)
     {
-    log_debug ("Update did not change state -- pattern is stable");
+    int changed, occupied;
+    int k = n < self->block_depth ? n : self->block_depth;
+    if (k >= 2)
+      life_step_blocked (self, k, &changed, &occupied);
+    else
+      {
+      k = 1;
+      life_step (self, &changed, &occupied);
+      }
+    n -= k;
+    self->changed = changed;
+
+    if (changed == 0)
+      {
+      log_debug ("Update did not change state -- pattern is stable");
       ret = FALSE;
-    }
+      }
 
-  if (!at_least_one)
-    {
-    log_debug ("All cells dead -- pattern is stable");
+    if (occupied == 0)
+      {
+      log_debug ("All cells dead -- pattern is stable");
       ret = FALSE;
+      }
     }
-
-  memcpy (self->cells, new_cells, self->w * self->h * sizeof (BYTE));
-  free (new_cells);
   LOG_OUT
   return ret;
   }
 
+/*==========================================================================
+
+  life_update
+
+  Update the entire grid to new cell states, based on existing
+  cell states. Returns FALSE if the pattern is stable -- nothing changed,
+  or everything is dead.
+
+*==========================================================================*/
+BOOL life_update (Life *self)
+  {
+  return life_step_n (self, 1);
+  }
+
 
@@ -9,18 +9,42 @@
 #pragma once
 
 #include "defs.h"
+#include "rule.h"
 
 struct _Life;
 typedef struct _Life Life;
 
+typedef enum
+  {
+  LIFE_TOPOLOGY_TORUS = 0,
+  LIFE_TOPOLOGY_PLANE,
+  LIFE_TOPOLOGY_KLEIN,
+  LIFE_TOPOLOGY_CROSS,
+  LIFE_TOPOLOGY_UNBOUNDED
+  } LifeTopology;
+
 BEGIN_DECLS
-Life        *life_create (int w, int h, const char *B, const char *S);
+Life        *life_create (int w, int h, const Rule *rule, 
+               LifeTopology topology);
 void        life_destroy (Life *self);
 int         life_get_width (const Life *self);
 int         life_get_height (const Life *self);
 int         life_get_state (const Life *self, int col, int row);
+int         life_get_population (const Life *self);
+int         life_get_changed (const Life *self);
+int         life_get_states (const Life *self);
+const Rule *life_get_rule (const Life *self);
+LifeTopology life_get_topology (const Life *self);
+BOOL        life_parse_topology (const char *name, LifeTopology *topology);
+void        life_set_follow (Life *self, BOOL follow);
+void        life_get_viewport (const Life *self, int *x, int *y);
+int         life_get_tile_count (const Life *self);
 BOOL        life_update (Life *self);
+BOOL        life_step_n (Life *self, int n);
 void        life_seed (Life *self, int percent);
+void        life_clear (Life *self);
+void        life_set_cell (Life *self, int x, int y, int state);
+void        life_set_rule (Life *self, const Rule *rule);
 END_DECLS
 
 
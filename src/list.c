@@ -4,11 +4,16 @@
   list.c
   Copyright (c)2000-2017 Kevin Boone, GPL v3.0
 
-  Methods for maintaining a single-linked list.
+  Methods for maintaining a list. Despite the name, the list is stored
+  as a contiguous array of pointers, which grows as necessary. So
+  indexed access with list_get() is cheap, and iterating over the
+  list by index does not have to walk a chain of links.
 
-  The list _should_ be thread safe, in that only one thread can operate
-  on it at a time. However, I can't say I've tested the thread-safety
-  very exhaustively. 
+  A list created with list_create() _should_ be thread safe, in that 
+  only one thread can operate on it at a time. However, I can't say I've
+  tested the thread-safety very exhaustively. A list created with
+  list_create_unlocked() does no locking at all, and must only be used
+  by one thread. 
 
 ============================================================================*/
 
@@ -21,33 +26,69 @@
 #include "log.h" 
 #include "string.h" 
 
-typedef struct _ListItem
-  {
-  struct _ListItem *next;
-  void *data;
-  } ListItem;
-
 struct _List
   {
   pthread_mutex_t mutex;
+  BOOL locked; // FALSE if created by list_create_unlocked
   ListItemFreeFn free_fn; 
-  ListItem *head;
+  void **items;
+  int length;
+  int capacity;
   };
 
+#define LIST_INITIAL_CAPACITY 8
+
 /*==========================================================================
-list_create
+list_lock
 *==========================================================================*/
-List *list_create (ListItemFreeFn free_fn)
+static inline void list_lock (List *self)
+  {
+  if (self->locked) pthread_mutex_lock (&self->mutex);
+  }
+
+/*==========================================================================
+list_unlock
+*==========================================================================*/
+static inline void list_unlock (List *self)
+  {
+  if (self->locked) pthread_mutex_unlock (&self->mutex);
+  }
+
+/*==========================================================================
+list_create_internal
+*==========================================================================*/
+static List *list_create_internal (ListItemFreeFn free_fn, BOOL locked)
   {
   LOG_IN
   List *list = malloc (sizeof (List));
   memset (list, 0, sizeof (List));
   list->free_fn = free_fn;
-  pthread_mutex_init (&list->mutex, NULL);
+  list->locked = locked;
+  if (locked)
+    pthread_mutex_init (&list->mutex, NULL);
   LOG_OUT
   return list;
   }
 
+/*==========================================================================
+list_create
+*==========================================================================*/
+List *list_create (ListItemFreeFn free_fn)
+  {
+  return list_create_internal (free_fn, TRUE);
+  }
+
+/*==========================================================================
+list_create_unlocked
+
+Create a list that does no locking. This is the right choice for lists
+that are only ever used by one thread, which is nearly all of them
+*==========================================================================*/
+List *list_create_unlocked (ListItemFreeFn free_fn)
+  {
+  return list_create_internal (free_fn, FALSE);
+  }
+
 /*==========================================================================
   list_create_strings
  
@@ -67,25 +108,39 @@ void list_destroy (List *self)
   LOG_IN
   if (self) 
     {
-    pthread_mutex_lock (&self->mutex);
-    ListItem *l = self->head;
-    while (l)
+    list_lock (self);
+    if (self->free_fn)
       {
-      if (self->free_fn)
-        self->free_fn (l->data);
-      ListItem *temp = l;
-      l = l->next;
-      free (temp);
+      for (int i = 0; i < self->length; i++)
+        self->free_fn (self->items[i]);
       }
-
-    pthread_mutex_unlock (&self->mutex);
-    pthread_mutex_destroy (&self->mutex);
+    free (self->items);
+    list_unlock (self);
+    if (self->locked)
+      pthread_mutex_destroy (&self->mutex);
     free (self);
     }
   LOG_OUT
   }
 
 
+/*==========================================================================
+list_grow
+Make sure there is room for at least one more item. The caller must 
+hold the lock.
+*==========================================================================*/
+static void list_grow (List *self)
+  {
+  if (self->length == self->capacity)
+    {
+    int capacity = self->capacity ? self->capacity * 2 
+      : LIST_INITIAL_CAPACITY;
+    self->items = realloc (self->items, capacity * sizeof (void *));
+    self->capacity = capacity;
+    }
+  }
+
+
 /*==========================================================================
 list_prepend
 Note that the caller must not modify or free the item added to the list. It
@@ -95,22 +150,37 @@ the supplied free function
 void list_prepend (List *self, void *item)
   {
   LOG_IN
-  pthread_mutex_lock (&self->mutex);
-  ListItem *i = malloc (sizeof (ListItem));
-  i->data = item;
-  i->next = NULL;
+  list_lock (self);
+  list_grow (self);
+  memmove (self->items + 1, self->items, self->length * sizeof (void *));
+  self->items[0] = item;
+  self->length++;
+  list_unlock (self);
+  LOG_OUT
+  }
 
-  if (self->head)
-    {
-    i->next = self->head;
-    self->head = i;
-    }
-  else
+
+/*==========================================================================
+  list_take_first
+  Remove the first item from the list, and return it, or NULL if the list
+    is empty. The item is not freed -- it now belongs to the caller. With
+    list_append, this allows a locked list to be used as a queue between
+    threads
+*==========================================================================*/
+void *list_take_first (List *self)
+  {
+  LOG_IN
+  void *ret = NULL;
+  list_lock (self);
+  if (self->length > 0)
     {
-    self->head = i;
+    ret = self->items[0];
+    self->length--;
+    memmove (self->items, self->items + 1, self->length * sizeof (void *));
     }
-  pthread_mutex_unlock (&self->mutex);
+  list_unlock (self);
   LOG_OUT
+  return ret;
   }
 
 
@@ -123,23 +193,10 @@ void list_prepend (List *self, void *item)
 void list_append (List *self, void *item)
   {
   LOG_IN
-  pthread_mutex_lock (&self->mutex);
-  ListItem *i = malloc (sizeof (ListItem));
-  i->data = item;
-  i->next = NULL;
-
-  if (self->head)
-    {
-    ListItem *l = self->head;
-    while (l->next)
-      l = l->next;
-    l->next = i;
-    }
-  else
-    {
-    self->head = i;
-    }
-  pthread_mutex_unlock (&self->mutex);
+  list_lock (self);
+  list_grow (self);
+  self->items[self->length++] = item;
+  list_unlock (self);
   LOG_OUT
   }
 
@@ -150,38 +207,27 @@ void list_append (List *self, void *item)
 int list_length (List *self)
   {
   LOG_IN
-  pthread_mutex_lock (&self->mutex);
-  ListItem *l = self->head;
-
-  int i = 0;
-  while (l != NULL)
-    {
-    l = l->next;
-    i++;
-    }
-
-  pthread_mutex_unlock (&self->mutex);
+  list_lock (self);
+  int i = self->length;
+  list_unlock (self);
   LOG_OUT
   return i;
   }
 
 /*==========================================================================
   list_get
+  Returns NULL if the index is out of range
 *==========================================================================*/
 void *list_get (List *self, int index)
   {
   LOG_IN
-  pthread_mutex_lock (&self->mutex);
-  ListItem *l = self->head;
-  int i = 0;
-  while (l != NULL && i != index)
-    {
-    l = l->next;
-    i++;
-    }
-  pthread_mutex_unlock (&self->mutex);
+  void *ret = NULL;
+  list_lock (self);
+  if (index >= 0 && index < self->length)
+    ret = self->items[index];
+  list_unlock (self);
   LOG_OUT
-  return l->data;
+  return ret;
   }
 
 
@@ -207,15 +253,13 @@ void list_dump (List *self)
 BOOL list_contains (List *self, const void *item, ListCompareFn fn)
   {
   LOG_IN
-  pthread_mutex_lock (&self->mutex);
-  ListItem *l = self->head;
+  list_lock (self);
   BOOL found = FALSE;
-  while (l != NULL && !found)
+  for (int i = 0; i < self->length && !found; i++)
     {
-    if (fn (l->data, item, NULL) == 0) found = TRUE; 
-    l = l->next;
+    if (fn (self->items[i], item, NULL) == 0) found = TRUE; 
     }
-  pthread_mutex_unlock (&self->mutex);
+  list_unlock (self);
   LOG_OUT
   return found; 
   }
@@ -240,33 +284,17 @@ all strings whose value is "dog". Use list_remove() for that.
 void list_remove_object (List *self, const void *item)
   {
   LOG_IN
-  pthread_mutex_lock (&self->mutex);
-  ListItem *l = self->head;
-  ListItem *last_good = NULL;
-  while (l != NULL)
+  list_lock (self);
+  int j = 0;
+  for (int i = 0; i < self->length; i++)
     {
-    if (l->data == item)
-      {
-      if (l == self->head)
-        {
-        self->head = l->next; // l-> next might be null
-        }
-      else
-        {
-        if (last_good) last_good->next = l->next;
-        }
-      self->free_fn (l->data);  
-      ListItem *temp = l->next;
-      free (l);
-      l = temp;
-      } 
+    if (self->items[i] == item)
+      self->free_fn (self->items[i]);  
     else
-      {
-      last_good = l;
-      l = l->next;
-      }
+      self->items[j++] = self->items[i];
     }
-  pthread_mutex_unlock (&self->mutex);
+  self->length = j;
+  list_unlock (self);
   LOG_OUT
   }
 
@@ -288,33 +316,17 @@ To remove one specific, known, item from the list, uselist_remove_object()
 void list_remove (List *self, const void *item, ListCompareFn fn)
   {
   LOG_IN
-  pthread_mutex_lock (&self->mutex);
-  ListItem *l = self->head;
-  ListItem *last_good = NULL;
-  while (l != NULL)
+  list_lock (self);
+  int j = 0;
+  for (int i = 0; i < self->length; i++)
     {
-    if (fn (l->data, item, NULL) == 0)
-      {
-      if (l == self->head)
-        {
-        self->head = l->next; // l-> next might be null
-        }
-      else
-        {
-        if (last_good) last_good->next = l->next;
-        }
-      self->free_fn (l->data);  
-      ListItem *temp = l->next;
-      free (l);
-      l = temp;
-      } 
+    if (fn (self->items[i], item, NULL) == 0)
+      self->free_fn (self->items[i]);  
     else
-      {
-      last_good = l;
-      l = l->next;
-      }
+      self->items[j++] = self->items[i];
     }
-  pthread_mutex_unlock (&self->mutex);
+  self->length = j;
+  list_unlock (self);
   LOG_OUT
   }
 
@@ -329,22 +341,20 @@ void list_remove_string (List *self, const char *item)
 
 /*==========================================================================
 list_clone
+The clone has the same locking behaviour as the original
 *==========================================================================*/
 List *list_clone (List *self, ListCopyFn copyFn)
   {
   LOG_IN
-  ListItemFreeFn free_fn = self->free_fn; 
-  List *new = list_create (free_fn);
+  List *new = list_create_internal (self->free_fn, self->locked);
 
-  pthread_mutex_lock (&self->mutex);
-  ListItem *l = self->head;
-  while (l != NULL)
-    {
-    void *data = copyFn (l->data);
-    list_append (new, data);
-    l = l->next;
-    }
-  pthread_mutex_unlock (&self->mutex);
+  list_lock (self);
+  new->items = malloc ((self->length ? self->length : 1) * sizeof (void *));
+  new->capacity = self->length;
+  for (int i = 0; i < self->length; i++)
+    new->items[i] = copyFn (self->items[i]);
+  new->length = self->length;
+  list_unlock (self);
 
   LOG_OUT
   return new;
@@ -359,46 +369,15 @@ List *list_clone (List *self, ListCopyFn copyFn)
   pointers to pointers to objects supplied by list_append, etc., not direct
   pointers.
 
-  The implementation is rather ugly -- we copy the list data pointers to a
-  flat array, then use qsort() on the array. Then we copy the list data
-  pointers back into the list. So the original chain of links remains
-  unchanged, but each link is now associated with a new data item.
+  Since the list data is already a flat array of pointers, we can
+  just qsort() it in place.
 *==========================================================================*/
 void list_sort (List *self, ListSortFn fn, void *user_data)
   {
   LOG_IN
-  pthread_mutex_lock (&self->mutex);
-
-  int length = list_length (self);
-  
-  void **temp = malloc (length * sizeof (void *));
-  ListItem *l = self->head;
-  int i = 0;
-  while (l != NULL)
-    {
-    temp[i] = l->data;
-    l = l->next;
-    i++;
-    }
-
-  // Sort temp
-
-  qsort_r (temp, length, sizeof (void *), fn, user_data); 
-  
-  // Copy the sorted data back
-   
-  l = self->head;
-  i = 0;
-  while (l != NULL)
-    {
-    l->data = temp[i];
-    l = l->next;
-    i++;
-    }
-  
-  free (temp);
-
-  pthread_mutex_unlock (&self->mutex);
+  list_lock (self);
+  qsort_r (self->items, self->length, sizeof (void *), fn, user_data); 
+  list_unlock (self);
   LOG_OUT
   }
 
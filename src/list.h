@@ -36,10 +36,12 @@ typedef void* (*ListCopyFn) (const void *orig);
 typedef void (*ListItemFreeFn) (void *);
 
 List   *list_create (ListItemFreeFn free_fn);
+List   *list_create_unlocked (ListItemFreeFn free_fn);
 void    list_destroy (List *);
 void    list_append (List *self, void *item);
 void    list_prepend (List *self, void *item);
 void   *list_get (List *self, int index);
+void   *list_take_first (List *self);
 void    list_dump (List *self);
 int     list_length (List *self);
 BOOL    list_contains (List *self, const void *item, ListCompareFn fn);
@@ -10,6 +10,21 @@
   define a function that will actually output the log messages to a
   specific place.
 
+  After log_start_async, messages are not written by the thread that
+  logs them, but by a background thread, so that a slow terminal or
+  pipe does not hold up the caller. Each message is formatted straight
+  into a fixed-size record in a ring of LOG_RING_RECORDS, without any
+  allocation or lock: the caller claims the next record by advancing
+  the ring's write position with a compare-and-swap, formats the
+  message into it, and then publishes it by setting the record's
+  sequence number, which is what the background thread waits for.
+  (This is Dmitry Vyukov's bounded queue, with a single consumer.)
+  The background thread is woken by a semaphore, which only costs a
+  system call when the thread is actually waiting. If the ring is full,
+  the message is counted and discarded, rather than waiting, and the
+  background thread reports how many were lost. Messages longer than
+  LOG_RECORD_LENGTH are truncated.
+
 ==========================================================================*/
 
 #define _GNU_SOURCE
@@ -19,12 +34,36 @@
 #include <string.h>
 #include <getopt.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include "defs.h" 
 #include "log.h" 
 
+// Must be a power of two
+#define LOG_RING_RECORDS 1024
+#define LOG_RECORD_LENGTH 256
+
+typedef struct _LogRecord
+  {
+  uint64_t seq; // pos + 1 when the record at pos is ready to be written
+  int level;
+  char text [LOG_RECORD_LENGTH];
+  } LogRecord;
+
 int log_level = LOG_INFO;
 static LogHandler log_handler = NULL;
 
+static BOOL log_async = FALSE;
+static LogRecord *log_ring = NULL;
+static uint64_t log_write_pos; // Shared by all the logging threads
+static uint64_t log_read_pos; // Only used by the background thread
+static uint64_t log_dropped;
+static uint64_t log_reported; // The value of log_dropped last reported
+static BOOL log_stop;
+static sem_t log_sem;
+static pthread_t log_thread;
+
 /*==========================================================================
   log_set_level
 ==========================================================================*/
@@ -34,18 +73,113 @@ void log_set_level (int level)
   }
 
 
+/*===========================================================================
+log_write
+============================================================================*/
+static void log_write (int level, const char *s)
+  {
+  if (log_handler)
+    log_handler (level, s);
+  else
+    fprintf (stderr, "%s\n", s);
+  }
+
+
+/*===========================================================================
+log_enqueue
+Format a message into the next free record, and publish it. Returns
+FALSE if the ring is full.
+============================================================================*/
+static BOOL log_enqueue (int level, const char *fmt, va_list ap)
+  {
+  uint64_t pos = __atomic_load_n (&log_write_pos, __ATOMIC_RELAXED);
+  LogRecord *record;
+  for (;;)
+    {
+    record = &log_ring [pos & (LOG_RING_RECORDS - 1)];
+    uint64_t seq = __atomic_load_n (&record->seq, __ATOMIC_ACQUIRE);
+    int64_t diff = (int64_t)(seq - pos);
+    if (diff == 0)
+      {
+      // The record is free; claim it, unless another thread just did
+      if (__atomic_compare_exchange_n (&log_write_pos, &pos, pos + 1, 
+            TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+      }
+    else if (diff < 0)
+      return FALSE; // Not yet written since it was last used
+    else
+      pos = __atomic_load_n (&log_write_pos, __ATOMIC_RELAXED);
+    }
+  record->level = level;
+  vsnprintf (record->text, LOG_RECORD_LENGTH, fmt, ap);
+  __atomic_store_n (&record->seq, pos + 1, __ATOMIC_RELEASE);
+  sem_post (&log_sem);
+  return TRUE;
+  }
+
+
+/*===========================================================================
+log_drain
+Write all the records that are ready, in order, and report any 
+messages that were dropped. Only the background thread calls this.
+============================================================================*/
+static void log_drain (void)
+  {
+  for (;;)
+    {
+    LogRecord *record = &log_ring [log_read_pos & (LOG_RING_RECORDS - 1)];
+    uint64_t seq = __atomic_load_n (&record->seq, __ATOMIC_ACQUIRE);
+    if (seq != log_read_pos + 1) break;
+    log_write (record->level, record->text);
+    // Free the record for the next time round the ring
+    __atomic_store_n (&record->seq, log_read_pos + LOG_RING_RECORDS,
+      __ATOMIC_RELEASE);
+    log_read_pos++;
+    }
+  uint64_t dropped = __atomic_load_n (&log_dropped, __ATOMIC_RELAXED);
+  if (dropped != log_reported)
+    {
+    char s[64];
+    snprintf (s, sizeof (s), "Dropped %llu log messages",
+      (unsigned long long)(dropped - log_reported));
+    log_write (LOG_WARNING, s);
+    log_reported = dropped;
+    }
+  }
+
+
+/*===========================================================================
+log_thread_main
+============================================================================*/
+static void *log_thread_main (void *arg)
+  {
+  for (;;)
+    {
+    while (sem_wait (&log_sem) != 0) {} // Only EINTR
+    log_drain();
+    if (__atomic_load_n (&log_stop, __ATOMIC_ACQUIRE)) break;
+    }
+  log_drain();
+  return NULL;
+  }
+
+
 /*===========================================================================
 log_v
 ============================================================================*/
 static void log_v (int level, const char *fmt, va_list ap)
   {
   if (level > log_level) return;
+  if (log_async)
+    {
+    if (!log_enqueue (level, fmt, ap))
+      __atomic_add_fetch (&log_dropped, 1, __ATOMIC_RELAXED);
+    return;
+    }
   char *s;
   vasprintf (&s, fmt, ap);
-  if (log_handler)
-    log_handler (level, s);
-  else
-    fprintf (stderr, "%s\n", s);
+  log_write (level, s);
   free (s);
   }
 
@@ -116,5 +250,55 @@ void log_set_handler (LogHandler handler)
   }
 
 
+/*===========================================================================
+log_start_async
+Start writing messages from a background thread. This should be done
+before any other threads are started, since they don't lock log_async.
+Returns FALSE, and leaves logging as it was, if the thread can't be 
+started.
+============================================================================*/
+BOOL log_start_async (void)
+  {
+  if (log_async) return TRUE;
+  log_ring = malloc (LOG_RING_RECORDS * sizeof (LogRecord));
+  for (int i = 0; i < LOG_RING_RECORDS; i++)
+    log_ring[i].seq = i;
+  log_write_pos = 0;
+  log_read_pos = 0;
+  log_dropped = 0;
+  log_reported = 0;
+  log_stop = FALSE;
+  sem_init (&log_sem, 0, 0);
+  if (pthread_create (&log_thread, NULL, log_thread_main, NULL) != 0)
+    {
+    sem_destroy (&log_sem);
+    free (log_ring);
+    log_ring = NULL;
+    return FALSE;
+    }
+  log_async = TRUE;
+  return TRUE;
+  }
+
+
+/*===========================================================================
+log_stop_async
+Write any messages that are waiting, stop the background thread, and
+go back to writing messages straight away. This should be done when 
+no other threads are logging, since their messages might be lost.
+============================================================================*/
+void log_stop_async (void)
+  {
+  if (!log_async) return;
+  log_async = FALSE;
+  __atomic_store_n (&log_stop, TRUE, __ATOMIC_RELEASE);
+  sem_post (&log_sem);
+  pthread_join (log_thread, NULL);
+  sem_destroy (&log_sem);
+  free (log_ring);
+  log_ring = NULL;
+  }
+
+
 
 
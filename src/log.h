@@ -46,6 +46,12 @@ void log_set_level (int level);
 /** Set the application-specific log handler */
 void log_set_handler (LogHandler logHandler);
 
+/** Write log messages from a background thread, not the caller's */
+BOOL log_start_async (void);
+
+/** Write any waiting messages, and go back to writing them directly */
+void log_stop_async (void);
+
 END_DECLS
 
 
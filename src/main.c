@@ -51,12 +51,16 @@ int main (int argc, char **argv)
   if (program_context_parse_command_line (context, argc, argv))
     {
     program_context_setup_logging (context, log_handler);
+    // Messages are written by a background thread, so that logging 
+    //   does not hold up the frame loop
+    log_start_async();
 
     log_info (NAME " starting up");
 
     ret = program_run (context);
 
     log_info (NAME " shutting down");
+    log_stop_async();
     }
 
   program_context_destroy (context);
@@ -0,0 +1,257 @@
+/*============================================================================
+
+  fblife
+  metrics.c
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  Metrics maintains a small, fixed-layout block of run-time statistics.
+  If metrics_publish() is called, the block lives in a POSIX shared
+  memory segment, /dev/shm/fblife.<pid>, so that external monitoring
+  tools can read it without any co-operation from this process.
+
+  There is only ever one writer (the main loop), so updates are
+  protected by a seqlock rather than a mutex -- the writer never
+  waits for anything, and readers just retry if they catch an update
+  in progress.
+
+============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "defs.h"
+#include "log.h"
+#include "metrics.h"
+
+struct _Metrics
+  {
+  MetricsData *data;
+  char *shm_name; // NULL if not published
+  int64_t rate_start_usec;
+  uint64_t rate_start_generation;
+  };
+
+
+/*==========================================================================
+  metrics_now_usec
+*==========================================================================*/
+static int64_t metrics_now_usec (void)
+  {
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  }
+
+
+/*==========================================================================
+  metrics_init_data
+*==========================================================================*/
+static void metrics_init_data (MetricsData *data)
+  {
+  memset (data, 0, sizeof (MetricsData));
+  data->magic = METRICS_MAGIC;
+  data->version = METRICS_VERSION;
+  data->pid = getpid();
+  }
+
+
+/*==========================================================================
+  metrics_create
+
+  The metrics block starts off in private memory; metrics_publish()
+  moves it into shared memory
+*==========================================================================*/
+Metrics *metrics_create (void)
+  {
+  LOG_IN
+  Metrics *self = malloc (sizeof (Metrics));
+  self->data = malloc (sizeof (MetricsData));
+  metrics_init_data (self->data);
+  self->shm_name = NULL;
+  self->rate_start_usec = metrics_now_usec();
+  self->rate_start_generation = 0;
+  LOG_OUT
+  return self;
+  }
+
+
+/*==========================================================================
+  metrics_publish
+
+  Create /dev/shm/fblife.<pid> and move the metrics block into it. On
+  failure, the block stays in private memory, and error is set. Does
+  nothing if the block is already published.
+*==========================================================================*/
+BOOL metrics_publish (Metrics *self, char **error)
+  {
+  LOG_IN
+  if (self->shm_name)
+    {
+    LOG_OUT
+    return TRUE;
+    }
+  BOOL ret = FALSE;
+  char *name;
+  asprintf (&name, "/" NAME ".%d", (int)getpid());
+  int fd = shm_open (name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd >= 0)
+    {
+    if (ftruncate (fd, sizeof (MetricsData)) == 0)
+      {
+      MetricsData *data = mmap (NULL, sizeof (MetricsData),
+        PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (data != MAP_FAILED)
+        {
+        memcpy (data, self->data, sizeof (MetricsData));
+        free (self->data);
+        self->data = data;
+        self->shm_name = name;
+        name = NULL;
+        log_debug ("Published metrics in shared memory %s", self->shm_name);
+        ret = TRUE;
+        }
+      }
+    if (!ret)
+      {
+      if (error)
+        asprintf (error, "Can't map metrics segment %s: %s", name,
+          strerror (errno));
+      shm_unlink (name);
+      }
+    close (fd);
+    }
+  else
+    {
+    if (error)
+      asprintf (error, "Can't create metrics segment %s: %s", name,
+        strerror (errno));
+    }
+  free (name);
+  LOG_OUT
+  return ret;
+  }
+
+
+/*==========================================================================
+  metrics_destroy
+
+  Removes the shared memory segment, if there is one
+*==========================================================================*/
+void metrics_destroy (Metrics *self)
+  {
+  LOG_IN
+  if (self)
+    {
+    if (self->shm_name)
+      {
+      munmap (self->data, sizeof (MetricsData));
+      shm_unlink (self->shm_name);
+      free (self->shm_name);
+      }
+    else
+      free (self->data);
+    free (self);
+    }
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+  metrics_begin_update
+*==========================================================================*/
+static void metrics_begin_update (Metrics *self)
+  {
+  __atomic_store_n (&self->data->seq, self->data->seq + 1,
+    __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+  }
+
+
+/*==========================================================================
+  metrics_end_update
+*==========================================================================*/
+static void metrics_end_update (Metrics *self)
+  {
+  __atomic_store_n (&self->data->seq, self->data->seq + 1,
+    __ATOMIC_RELEASE);
+  }
+
+
+/*==========================================================================
+  metrics_add_frame
+
+  Record that a frame has been displayed, having taken the simulation
+  forward by the specified number of generations. frame_usec is the
+  time spent computing and drawing the frame, not including any sleep.
+*==========================================================================*/
+void metrics_add_frame (Metrics *self, uint64_t generations,
+       uint64_t population, int64_t frame_usec)
+  {
+  MetricsData *data = self->data;
+
+  int bucket = 0;
+  while (bucket < METRICS_HIST_BUCKETS - 1 && (frame_usec >> bucket) > 0)
+    bucket++;
+
+  int64_t now = metrics_now_usec();
+  int64_t elapsed = now - self->rate_start_usec;
+
+  metrics_begin_update (self);
+  data->generation += generations;
+  data->cycle += generations;
+  data->population = population;
+  data->frames++;
+  data->frame_time_hist [bucket]++;
+  if (elapsed >= 1000000)
+    {
+    data->gens_per_sec = (data->generation - self->rate_start_generation)
+      * 1000000.0 / elapsed;
+    self->rate_start_usec = now;
+    self->rate_start_generation = data->generation;
+    }
+  metrics_end_update (self);
+  }
+
+
+/*==========================================================================
+  metrics_add_reseed
+*==========================================================================*/
+void metrics_add_reseed (Metrics *self)
+  {
+  metrics_begin_update (self);
+  self->data->reseeds++;
+  self->data->cycle = 0;
+  metrics_end_update (self);
+  }
+
+
+/*==========================================================================
+  metrics_read
+
+  Take a consistent snapshot of the metrics, using the same seqlock
+  protocol that an external reader would use. Returns FALSE if a
+  consistent copy could not be obtained (which should never happen,
+  as the writer does not hold the lock for long)
+*==========================================================================*/
+BOOL metrics_read (const Metrics *self, MetricsData *data)
+  {
+  for (int tries = 0; tries < 1000; tries++)
+    {
+    uint32_t seq1 = __atomic_load_n (&self->data->seq, __ATOMIC_ACQUIRE);
+    if (seq1 & 1) continue;
+    memcpy (data, self->data, sizeof (MetricsData));
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    uint32_t seq2 = __atomic_load_n (&self->data->seq, __ATOMIC_RELAXED);
+    if (seq1 == seq2) return TRUE;
+    }
+  return FALSE;
+  }
+
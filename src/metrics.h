@@ -0,0 +1,59 @@
+/*============================================================================
+
+  fblife
+  metrics.h
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  The layout of MetricsData is the published interface to external
+  monitoring tools, which map /dev/shm/fblife.<pid> read-only. Fields may
+  be appended in future versions, but existing offsets must not change;
+  bump METRICS_VERSION if they do.
+
+  Readers must use the seqlock protocol: read 'seq'; if it is odd, retry;
+  copy the structure; read 'seq' again; if it has changed, retry.
+
+============================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+#include "defs.h"
+
+#define METRICS_MAGIC 0x46424C46 // "FLBF"
+#define METRICS_VERSION 1
+
+// Frame time histogram. Bucket n counts frames that took less than
+//   2^n microseconds (excluding the sleep interval); the last bucket
+//   collects everything longer
+#define METRICS_HIST_BUCKETS 24
+
+typedef struct _MetricsData
+  {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t seq;          // Odd while an update is in progress
+  int32_t pid;
+  uint64_t generation;   // Generations computed since start-up
+  uint64_t cycle;        // Generations since the last reseed
+  uint64_t population;   // Live cells in the current generation
+  uint64_t reseeds;
+  uint64_t frames;
+  double gens_per_sec;   // Averaged over the last second or so
+  uint64_t frame_time_hist [METRICS_HIST_BUCKETS];
+  } MetricsData;
+
+struct _Metrics;
+typedef struct _Metrics Metrics;
+
+BEGIN_DECLS
+
+Metrics    *metrics_create (void);
+BOOL        metrics_publish (Metrics *self, char **error);
+void        metrics_destroy (Metrics *self);
+void        metrics_add_frame (Metrics *self, uint64_t generations,
+              uint64_t population, int64_t frame_usec);
+void        metrics_add_reseed (Metrics *self);
+BOOL        metrics_read (const Metrics *self, MetricsData *data);
+
+END_DECLS
+
@@ -0,0 +1,247 @@
+/*============================================================================
+
+  fblife
+  output.c
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  An Output is a framebuffer that frames are to be shown on, the 
+  position on it at which to show them, and the factor to magnify 
+  them by. 
+
+  A threaded output does the copying to the framebuffer in its own 
+  thread, so that a slow device -- an SPI panel, for example -- does
+  not hold up the simulation or the other outputs. output_submit() 
+  just copies the frame into a 'pending' region and wakes the thread.
+  If the thread is still busy with an earlier frame when another is 
+  submitted, the pending frame is replaced by the newer one, and 
+  counted as dropped: a slow output always shows the latest frame it
+  can, rather than falling further and further behind.
+
+  An output that is not threaded copies the frame to the framebuffer
+  directly in output_submit(), which saves a copy when there is only
+  one output.
+
+============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <pthread.h>
+#include "defs.h"
+#include "log.h"
+#include "framebuffer.h"
+#include "region.h"
+#include "output.h"
+#include "trace.h"
+
+struct _Output
+  {
+  FrameBuffer *fb;
+  int x;
+  int y;
+  int scale;
+  BOOL threaded;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  Region *pending; // Latest frame submitted, not yet shown
+  Region *showing; // Frame the thread is copying to the framebuffer
+  BOOL have_pending;
+  BOOL stop;
+  int dropped;
+  };
+
+
+/*==========================================================================
+
+  output_thread
+
+*==========================================================================*/
+static void *output_thread (void *arg)
+  {
+  Output *self = arg;
+  TRACE_THREAD_NAME ("output");
+  pthread_mutex_lock (&self->mutex);
+  for (;;)
+    {
+    while (!self->have_pending && !self->stop)
+      pthread_cond_wait (&self->cond, &self->mutex);
+    if (self->stop) break;
+    Region *temp = self->showing;
+    self->showing = self->pending;
+    self->pending = temp;
+    self->have_pending = FALSE;
+    pthread_mutex_unlock (&self->mutex);
+
+    TRACE_BEGIN (t);
+    region_to_fb_scaled (self->showing, self->fb, self->x, self->y, 
+      self->scale);
+    TRACE_END (t, "output", "blit");
+
+    pthread_mutex_lock (&self->mutex);
+    }
+  pthread_mutex_unlock (&self->mutex);
+  return NULL;
+  }
+
+
+/*==========================================================================
+
+  output_create
+
+  The output takes ownership of the framebuffer, which should already
+  have been initialized. Frames will be drawn with their top-left 
+  corner at x,y, and each pixel magnified to a scale x scale square
+
+*==========================================================================*/
+Output *output_create (FrameBuffer *fb, int x, int y, int scale, 
+       BOOL threaded)
+  {
+  LOG_IN
+  Output *self = malloc (sizeof (Output));
+  self->fb = fb;
+  self->x = x;
+  self->y = y;
+  self->scale = scale;
+  self->threaded = threaded;
+  self->pending = NULL;
+  self->showing = NULL;
+  self->have_pending = FALSE;
+  self->stop = FALSE;
+  self->dropped = 0;
+  if (threaded)
+    {
+    pthread_mutex_init (&self->mutex, NULL);
+    pthread_cond_init (&self->cond, NULL);
+    pthread_create (&self->thread, NULL, output_thread, self);
+    }
+  LOG_OUT
+  return self;
+  }
+
+
+/*==========================================================================
+
+  output_destroy
+
+  Stops the thread, if there is one, and closes the framebuffer. A 
+  frame that is pending at this point is not shown
+
+*==========================================================================*/
+void output_destroy (Output *self)
+  {
+  LOG_IN
+  if (self)
+    {
+    if (self->threaded)
+      {
+      pthread_mutex_lock (&self->mutex);
+      self->stop = TRUE;
+      pthread_cond_signal (&self->cond);
+      pthread_mutex_unlock (&self->mutex);
+      pthread_join (self->thread, NULL);
+      pthread_cond_destroy (&self->cond);
+      pthread_mutex_destroy (&self->mutex);
+      }
+    if (self->pending) region_destroy (self->pending);
+    if (self->showing) region_destroy (self->showing);
+    framebuffer_deinit (self->fb);
+    framebuffer_destroy (self->fb);
+    free (self);
+    }
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+
+  output_submit
+
+  Show a frame. Every frame submitted to an output must be the same 
+  size
+
+*==========================================================================*/
+void output_submit (Output *self, const Region *frame)
+  {
+  LOG_IN
+  if (self->threaded)
+    {
+    pthread_mutex_lock (&self->mutex);
+    if (self->pending == NULL)
+      {
+      int w = region_get_width (frame), h = region_get_height (frame);
+      self->pending = region_create (w, h);
+      self->showing = region_create (w, h);
+      }
+    if (self->have_pending)
+      self->dropped++;
+    region_copy (self->pending, frame);
+    self->have_pending = TRUE;
+    pthread_cond_signal (&self->cond);
+    pthread_mutex_unlock (&self->mutex);
+    }
+  else
+    {
+    TRACE_BEGIN (t);
+    region_to_fb_scaled (frame, self->fb, self->x, self->y, self->scale);
+    TRACE_END (t, "output", "blit");
+    }
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+  output_get_framebuffer
+*==========================================================================*/
+FrameBuffer *output_get_framebuffer (const Output *self)
+  {
+  return self->fb;
+  }
+
+
+/*==========================================================================
+  output_get_dropped
+
+  The number of frames that were replaced by newer ones before the
+  output thread could show them
+*==========================================================================*/
+int output_get_dropped (const Output *self)
+  {
+  int ret = 0;
+  if (self->threaded)
+    {
+    pthread_mutex_lock ((pthread_mutex_t *)&self->mutex);
+    ret = self->dropped;
+    pthread_mutex_unlock ((pthread_mutex_t *)&self->mutex);
+    }
+  return ret;
+  }
+
+
+/*==========================================================================
+  output_get_x
+*==========================================================================*/
+int output_get_x (const Output *self)
+  {
+  return self->x;
+  }
+
+
+/*==========================================================================
+  output_get_y
+*==========================================================================*/
+int output_get_y (const Output *self)
+  {
+  return self->y;
+  }
+
+
+/*==========================================================================
+  output_get_scale
+*==========================================================================*/
+int output_get_scale (const Output *self)
+  {
+  return self->scale;
+  }
+
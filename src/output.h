@@ -0,0 +1,31 @@
+/*============================================================================
+
+  fblife
+  output.h
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+============================================================================*/
+
+#pragma once
+
+#include "defs.h"
+#include "framebuffer.h"
+#include "region.h"
+
+struct _Output;
+typedef struct _Output Output;
+
+BEGIN_DECLS
+
+Output     *output_create (FrameBuffer *fb, int x, int y, int scale,
+              BOOL threaded);
+void        output_destroy (Output *self);
+void        output_submit (Output *self, const Region *frame);
+FrameBuffer *output_get_framebuffer (const Output *self);
+int         output_get_dropped (const Output *self);
+int         output_get_x (const Output *self);
+int         output_get_y (const Output *self);
+int         output_get_scale (const Output *self);
+
+END_DECLS
+
@@ -0,0 +1,523 @@
+/*============================================================================
+
+  fblife
+  panel.c
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  A Panel is one Life simulation, together with everything needed to 
+  display it: its colours, cell size, position on the screen, and a
+  Region to draw it in. It also keeps track of when to reseed. 
+
+  The display can show several panels, which are independent of one
+  another, so they can be stepped and drawn in separate threads. The
+  main loop then copies the panels' regions to the framebuffer. 
+
+  When there is only one panel and nothing else to combine it with, 
+  panel_draw_to_fb() can draw the cells straight into the framebuffer
+  instead, in its own pixel format, without going through the Region.
+  The cells are then plain squares of the fill colour, without borders.
+  For each row of cells, one line of pixels is built by looking up each
+  cell's state in a table of native pixel values, and repeating it 
+  across the cell; the line is then copied, with memcpy(), to the 
+  remaining lines of the row. 
+
+============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <stdint.h>
+#include "defs.h"
+#include "log.h"
+#include "rule.h"
+#include "life.h"
+#include "region.h"
+#include "framebuffer.h"
+#include "pattern.h"
+#include "recorder.h"
+#include "panel.h"
+#include "trace.h"
+
+struct _Panel
+  {
+  Life *life;
+  Region *region;
+  BYTE colours[6]; // Fill RGB, then border RGB, for live cells
+  BYTE *palette; // See panel_make_palette
+  uint32_t *native_palette; // Fill colours in the format of native_fb
+  const FrameBuffer *native_fb;
+  int x; // Position of the region on the screen
+  int y;
+  int cell_size;
+  int percent; // Initial percentage of live cells
+  int max_cycles; // Reseed after this many frames
+  int generations_per_frame;
+  int cycle;
+  int generations; // Generations advanced by the last panel_step
+  BOOL reseeded; // TRUE if the last panel_step reseeded
+  };
+
+
+/*==========================================================================
+
+  panel_make_palette 
+
+  Make a table of colours, indexed by cell state. Each entry has six
+  bytes -- the fill RGB, then the border RGB. Live cells get the
+  full colours; dying cells (in Generations rules) get progressively
+  darker shades. The caller must free the result.
+
+==========================================================================*/
+static BYTE *panel_make_palette (int states, BYTE red, BYTE green, 
+       BYTE blue, BYTE red_border, BYTE green_border, BYTE blue_border)
+  {
+  BYTE *palette = malloc (states * 6);
+  memset (palette, 0, 6);
+  for (int state = 1; state < states; state++)
+    {
+    // State 1 has factor 1; the last dying state is the dimmest
+    int num = (state == 1) ? 1 : states - state; 
+    int den = (state == 1) ? 1 : states - 1;
+    BYTE *p = palette + state * 6;
+    p[0] = red * num / den; 
+    p[1] = green * num / den; 
+    p[2] = blue * num / den; 
+    p[3] = red_border * num / den; 
+    p[4] = green_border * num / den; 
+    p[5] = blue_border * num / den; 
+    }
+  return palette;
+  }
+
+
+/*==========================================================================
+
+  panel_create
+
+  The panel takes ownership of the Life, and seeds it. In a hexagonal
+  grid, alternate rows are offset by half a cell, so the region needs
+  to be half a cell wider.
+
+==========================================================================*/
+Panel *panel_create (Life *life, int x, int y, int cell_size,
+       BYTE red, BYTE green, BYTE blue, BYTE red_border, 
+       BYTE green_border, BYTE blue_border, int percent, 
+       int max_cycles, int generations_per_frame)
+  {
+  LOG_IN
+  Panel *self = malloc (sizeof (Panel));
+  const Rule *rule = life_get_rule (life);
+  int region_width = life_get_width (life) * cell_size;
+  if (rule_get_family (rule) == RULE_FAMILY_HEX) 
+    region_width += cell_size / 2;
+  self->life = life;
+  self->region = region_create (region_width, 
+    life_get_height (life) * cell_size);
+  self->palette = NULL;
+  self->native_palette = NULL;
+  panel_set_colours (self, red, green, blue, red_border, green_border, 
+    blue_border);
+  self->x = x;
+  self->y = y;
+  self->cell_size = cell_size;
+  self->percent = percent;
+  self->max_cycles = max_cycles;
+  self->generations_per_frame = generations_per_frame;
+  self->cycle = 1;
+  self->generations = 0;
+  self->reseeded = FALSE;
+  life_seed (life, percent);
+  LOG_OUT
+  return self;
+  }
+
+
+/*==========================================================================
+
+  panel_set_colours
+
+  Set the fill and border colours of live cells, from which those of
+  dying cells are worked out
+
+==========================================================================*/
+void panel_set_colours (Panel *self, BYTE red, BYTE green, BYTE blue, 
+       BYTE red_border, BYTE green_border, BYTE blue_border)
+  {
+  LOG_IN
+  BYTE colours[6] = { red, green, blue, red_border, green_border, 
+    blue_border };
+  memcpy (self->colours, colours, sizeof (colours));
+  free (self->palette);
+  self->palette = panel_make_palette (life_get_states (self->life), 
+    red, green, blue, red_border, green_border, blue_border); 
+  // Make panel_draw_to_fb rebuild its palette
+  free (self->native_palette);
+  self->native_palette = NULL;
+  self->native_fb = NULL;
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+
+  panel_set_rule
+
+  Change the rule, keeping the cells. The width of the region depends
+  on whether the grid is hexagonal, so that can't be changed. Returns
+  FALSE, and sets error, if it would need to be.
+
+==========================================================================*/
+BOOL panel_set_rule (Panel *self, const Rule *rule, char **error)
+  {
+  LOG_IN
+  BOOL ret = TRUE;
+  BOOL hex = (rule_get_family (rule) == RULE_FAMILY_HEX);
+  BOOL was_hex = 
+    (rule_get_family (life_get_rule (self->life)) == RULE_FAMILY_HEX);
+  if (hex != was_hex)
+    {
+    if (error)
+      asprintf (error, "Can't change to or from a hexagonal rule while "
+        "running");
+    ret = FALSE;
+    }
+  else
+    {
+    life_set_rule (self->life, rule);
+    const BYTE *c = self->colours;
+    panel_set_colours (self, c[0], c[1], c[2], c[3], c[4], c[5]);
+    }
+  LOG_OUT
+  return ret;
+  }
+
+
+/*==========================================================================
+
+  panel_set_options
+
+  Change the settings that control seeding and stepping; they take 
+  effect from the next panel_step
+
+==========================================================================*/
+void panel_set_options (Panel *self, int percent, int max_cycles, 
+       int generations_per_frame)
+  {
+  self->percent = percent;
+  self->max_cycles = max_cycles;
+  self->generations_per_frame = generations_per_frame;
+  }
+
+
+/*==========================================================================
+
+  panel_reseed
+
+  Start again from a new random seed
+
+==========================================================================*/
+void panel_reseed (Panel *self)
+  {
+  LOG_IN
+  life_seed (self->life, self->percent); 
+  self->cycle = 1;
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+
+  panel_load
+
+  Start again from a pattern in an RLE file. Returns FALSE, and sets 
+  error, if it can't be loaded, in which case the panel carries on as 
+  it was. The pattern runs until it becomes stable, or for the maximum
+  number of cycles, just like a random seed.
+
+==========================================================================*/
+BOOL panel_load (Panel *self, const char *filename, char **error)
+  {
+  LOG_IN
+  BOOL ret = pattern_load_rle (self->life, filename, error);
+  if (ret)
+    self->cycle = 1;
+  LOG_OUT
+  return ret;
+  }
+
+
+/*==========================================================================
+  panel_destroy
+==========================================================================*/
+void panel_destroy (Panel *self)
+  {
+  LOG_IN
+  if (self)
+    {
+    if (self->life) life_destroy (self->life);
+    if (self->region) region_destroy (self->region);
+    if (self->palette) free (self->palette);
+    if (self->native_palette) free (self->native_palette);
+    free (self);
+    }
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+
+  panel_draw
+
+  Draw the cells into the panel's region. For hexagonal rules, odd 
+  rows are drawn offset to the right by half a cell. Cells smaller than
+  three pixels have no room for a border and a gap, so they are drawn
+  as plain squares of the fill colour, as panel_draw_to_fb does.
+
+==========================================================================*/
+void panel_draw (Panel *self)
+  {
+  LOG_IN
+  TRACE_BEGIN (t);
+  Region *region = self->region;
+  const Life *life = self->life;
+  int cell_size = self->cell_size;
+  int w = life_get_width (life);
+  int h = life_get_height (life);
+  BOOL hex = (rule_get_family (life_get_rule (life)) == RULE_FAMILY_HEX);
+
+  region_fill_rect (region, 0, 0, region_get_width (region),
+    region_get_height (region), 0, 0, 0);
+
+  for (int row = 0; row < h; row++)
+    {
+    int y = row * cell_size;
+    int offset = (hex && (row & 1)) ? cell_size / 2 : 0;
+    for (int col = 0; col < w; col++)
+      {
+      int x = col * cell_size + offset;
+
+      int state = life_get_state (life, col, row);
+      if (state)
+        {
+        const BYTE *p = self->palette + state * 6;
+        if (cell_size < 3)
+          {
+          region_fill_rect (region, x, y, x + cell_size, y + cell_size, 
+            p[0], p[1], p[2]); 
+          continue;
+          }
+        region_draw_rect (region, x, y, x + cell_size - 2, 
+          y + cell_size - 2, p[3], p[4], p[5]); 
+        region_fill_rect (region, x + 1, y + 1, x + cell_size - 3, 
+          y + cell_size - 3, p[0], p[1], p[2]); 
+        }
+      }
+    }
+
+  TRACE_END (t, "panel", "draw");
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+
+  panel_fill_line
+
+  Fill n pixels of a framebuffer line with a native pixel value 
+
+==========================================================================*/
+static inline BYTE *panel_fill_line (BYTE *p, uint32_t pixel, int n, 
+       int bytes)
+  {
+  if (bytes == 4)
+    {
+    uint32_t *q = (uint32_t *)p;
+    for (int i = 0; i < n; i++) q[i] = pixel;
+    }
+  else
+    {
+    uint16_t *q = (uint16_t *)p;
+    for (int i = 0; i < n; i++) q[i] = pixel;
+    }
+  return p + n * bytes;
+  }
+
+/*==========================================================================
+
+  panel_draw_to_fb
+
+  Draw the cells directly into the framebuffer, with the top-left 
+  corner at x,y -- see the notes at the top of this file. Only 16- and
+  32-bit pixels are handled this way; for anything else, the panel is
+  drawn via its region as usual.
+
+==========================================================================*/
+void panel_draw_to_fb (Panel *self, FrameBuffer *fb, int x, int y)
+  {
+  LOG_IN
+  TRACE_BEGIN (t);
+  int bytes = framebuffer_get_bytes_per_pixel (fb);
+  if (bytes != 2 && bytes != 4)
+    {
+    panel_draw (self);
+    region_to_fb (self->region, fb, x, y);
+    TRACE_END (t, "panel", "draw_to_fb");
+    LOG_OUT
+    return;
+    }
+
+  const Life *life = self->life;
+  int states = life_get_states (life);
+  if (self->native_fb != fb)
+    {
+    free (self->native_palette);
+    self->native_palette = malloc (states * sizeof (uint32_t));
+    for (int state = 0; state < states; state++)
+      {
+      const BYTE *p = self->palette + state * 6;
+      self->native_palette [state] = framebuffer_map_rgb (fb, p[0], p[1], 
+        p[2]);
+      }
+    self->native_fb = fb;
+    }
+
+  int cell_size = self->cell_size;
+  int w = life_get_width (life);
+  int h = life_get_height (life);
+  BOOL hex = (rule_get_family (life_get_rule (life)) == RULE_FAMILY_HEX);
+  int stride = framebuffer_get_stride (fb);
+  int line_bytes = region_get_width (self->region) * bytes;
+  BYTE *data = framebuffer_get_data (fb) + y * stride + x * bytes;
+  const uint32_t *native = self->native_palette;
+
+  for (int row = 0; row < h; row++)
+    {
+    BYTE *line = data + row * cell_size * stride;
+    BYTE *p = line;
+    // In a hexagonal grid, the region has an extra half cell of 
+    //   background, on the left of odd rows and the right of even ones
+    if (hex && (row & 1)) 
+      p = panel_fill_line (p, native[0], cell_size / 2, bytes);
+    for (int col = 0; col < w; col++)
+      p = panel_fill_line (p, native [life_get_state (life, col, row)], 
+        cell_size, bytes);
+    if (hex && !(row & 1)) 
+      p = panel_fill_line (p, native[0], cell_size / 2, bytes);
+    for (int i = 1; i < cell_size; i++)
+      memcpy (line + i * stride, line, line_bytes);
+    }
+  TRACE_END (t, "panel", "draw_to_fb");
+  LOG_OUT
+  }
+
+/*==========================================================================
+
+  panel_record
+
+  Hand the region, as last drawn by panel_draw, to the recorder, and
+  take another to draw the next frame in
+
+==========================================================================*/
+void panel_record (Panel *self, Recorder *recorder)
+  {
+  self->region = recorder_submit (recorder, self->region);
+  }
+
+/*==========================================================================
+
+  panel_step
+
+  Advance the simulation by one frame's worth of generations or, if 
+  it has run for the maximum number of frames or become stable, 
+  reseed it.
+
+==========================================================================*/
+void panel_step (Panel *self)
+  {
+  LOG_IN
+  TRACE_BEGIN (t);
+  self->generations = 0;
+  self->reseeded = FALSE;
+  if (self->cycle >= self->max_cycles)
+    {
+    log_debug ("Restarting with new seed");
+    self->reseeded = TRUE;
+    }
+  else
+    {
+    BOOL viable = life_step_n (self->life, self->generations_per_frame);
+    self->generations = self->generations_per_frame;
+    if (!viable)
+      {
+      log_debug ("Restarting with new seed");
+      self->reseeded = TRUE;
+      }
+    }
+  if (self->reseeded)
+    {
+    life_seed (self->life, self->percent); 
+    self->cycle = 0;
+    }
+  self->cycle++;
+  TRACE_END (t, "panel", "step");
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+  panel_get_life
+==========================================================================*/
+Life *panel_get_life (const Panel *self)
+  {
+  return self->life;
+  }
+
+
+/*==========================================================================
+  panel_get_region
+==========================================================================*/
+const Region *panel_get_region (const Panel *self)
+  {
+  return self->region;
+  }
+
+
+/*==========================================================================
+  panel_get_x
+==========================================================================*/
+int panel_get_x (const Panel *self)
+  {
+  return self->x;
+  }
+
+
+/*==========================================================================
+  panel_get_y
+==========================================================================*/
+int panel_get_y (const Panel *self)
+  {
+  return self->y;
+  }
+
+
+/*==========================================================================
+  panel_get_generations
+
+  The number of generations the last panel_step advanced by -- zero
+  if it reseeded instead
+==========================================================================*/
+int panel_get_generations (const Panel *self)
+  {
+  return self->generations;
+  }
+
+
+/*==========================================================================
+  panel_get_reseeded
+==========================================================================*/
+BOOL panel_get_reseeded (const Panel *self)
+  {
+  return self->reseeded;
+  }
+
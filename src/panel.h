@@ -0,0 +1,47 @@
+/*============================================================================
+
+  fblife
+  panel.h
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+============================================================================*/
+
+#pragma once
+
+#include "defs.h"
+#include "life.h"
+#include "region.h"
+#include "framebuffer.h"
+#include "recorder.h"
+
+struct _Panel;
+typedef struct _Panel Panel;
+
+BEGIN_DECLS
+
+Panel      *panel_create (Life *life, int x, int y, int cell_size,
+              BYTE red, BYTE green, BYTE blue, BYTE red_border, 
+              BYTE green_border, BYTE blue_border, int percent, 
+              int max_cycles, int generations_per_frame);
+void        panel_destroy (Panel *self);
+void        panel_set_colours (Panel *self, BYTE red, BYTE green, 
+              BYTE blue, BYTE red_border, BYTE green_border, 
+              BYTE blue_border);
+BOOL        panel_set_rule (Panel *self, const Rule *rule, char **error);
+void        panel_set_options (Panel *self, int percent, int max_cycles, 
+              int generations_per_frame);
+void        panel_reseed (Panel *self);
+BOOL        panel_load (Panel *self, const char *filename, char **error);
+void        panel_draw (Panel *self);
+void        panel_draw_to_fb (Panel *self, FrameBuffer *fb, int x, int y);
+void        panel_record (Panel *self, Recorder *recorder);
+void        panel_step (Panel *self);
+Life       *panel_get_life (const Panel *self);
+const Region *panel_get_region (const Panel *self);
+int         panel_get_x (const Panel *self);
+int         panel_get_y (const Panel *self);
+int         panel_get_generations (const Panel *self);
+BOOL        panel_get_reseeded (const Panel *self);
+
+END_DECLS
+
@@ -0,0 +1,208 @@
+/*============================================================================
+
+  fblife
+  pattern.c
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  Load patterns from files in the RLE format used by Golly and most
+  pattern collections. An RLE file has comment lines starting with '#',
+  then a header line like "x = 3, y = 3, rule = B3/S23", and then the
+  cells, row by row. In the cells, 'b' is a dead cell and 'o' a live
+  one; in multi-state patterns, '.' is dead, and 'A', 'B'... are states
+  1, 2... . '$' ends a row, and '!' ends the pattern. Any of these can
+  be preceded by a repeat count. The rule in the header is ignored --
+  the pattern is loaded into whatever rule is running. States above 24,
+  which need two characters, are not supported.
+
+============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include "defs.h"
+#include "log.h"
+#include "life.h"
+#include "pattern.h"
+
+
+/*==========================================================================
+
+  pattern_parse_header
+
+  Parse "x = N, y = M, ..." -- the other fields, if any, are ignored.
+  Returns FALSE if x or y is missing or invalid.
+
+==========================================================================*/
+static BOOL pattern_parse_header (const char *line, int *w, int *h)
+  {
+  *w = -1;
+  *h = -1;
+  const char *s = line;
+  while (*s)
+    {
+    while (isspace ((unsigned char)*s) || *s == ',') s++;
+    char key = *s;
+    if (!key) break;
+    s++;
+    while (isspace ((unsigned char)*s)) s++;
+    if (*s == '=' && (key == 'x' || key == 'y'))
+      {
+      int n = atoi (s + 1);
+      if (key == 'x') *w = n; else *h = n;
+      }
+    while (*s && *s != ',') s++;
+    }
+  return *w > 0 && *h > 0;
+  }
+
+
+/*==========================================================================
+
+  pattern_load_rle
+
+  Clear the grid, then load the pattern from an RLE file into the
+  middle of it (the middle of the viewport, for an unbounded universe).
+  Returns FALSE, and sets error, if the file can't be read or is not
+  valid, if the pattern is larger than the grid, or if it uses more
+  states than the rule has. The grid is not changed in that case.
+
+==========================================================================*/
+BOOL pattern_load_rle (Life *life, const char *filename, char **error)
+  {
+  LOG_IN
+  BOOL ret = TRUE;
+  FILE *f = fopen (filename, "r");
+  if (f == NULL)
+    {
+    if (error)
+      asprintf (error, "Can't open %s: %s", filename, strerror (errno));
+    LOG_OUT
+    return FALSE;
+    }
+
+  int w = 0, h = 0;
+  BYTE *cells = NULL;
+  BOOL header = FALSE, done = FALSE;
+  int x = 0, y = 0, count = 0;
+  int states = life_get_states (life);
+  char *line = NULL;
+  size_t len = 0;
+  while (ret && !done && getline (&line, &len, f) >= 0)
+    {
+    if (line[0] == '#' || line [strspn (line, " \t\r\n")] == 0)
+      {
+      // Comment or blank line
+      }
+    else if (!header)
+      {
+      if (pattern_parse_header (line, &w, &h))
+        {
+        if (w > life_get_width (life) || h > life_get_height (life))
+          {
+          if (error)
+            asprintf (error, "Pattern is %d x %d, which is larger than "
+              "the grid", w, h);
+          ret = FALSE;
+          }
+        else
+          cells = calloc (w * h, sizeof (BYTE));
+        header = TRUE;
+        }
+      else
+        {
+        if (error)
+          asprintf (error, "%s is not an RLE file: no valid header",
+            filename);
+        ret = FALSE;
+        }
+      }
+    else
+      {
+      for (const char *s = line; *s && ret && !done; s++)
+        {
+        char c = *s;
+        int state = -1;
+        if (isdigit ((unsigned char)c))
+          count = count * 10 + (c - '0');
+        else if (isspace ((unsigned char)c))
+          {
+          // Ignore
+          }
+        else if (c == '!')
+          done = TRUE;
+        else if (c == '$')
+          {
+          y += count ? count : 1;
+          x = 0;
+          count = 0;
+          }
+        else if (c == 'b' || c == '.')
+          state = 0;
+        else if (c == 'o')
+          state = 1;
+        else if (c >= 'A' && c <= 'X')
+          state = c - 'A' + 1;
+        else
+          {
+          if (error)
+            asprintf (error, "Unexpected '%c' in pattern %s", c, filename);
+          ret = FALSE;
+          }
+
+        if (state >= states)
+          {
+          if (error)
+            asprintf (error, "Pattern %s has more states than the rule",
+              filename);
+          ret = FALSE;
+          }
+        else if (state >= 0)
+          {
+          int n = count ? count : 1;
+          if (x + n > w || y >= h)
+            {
+            if (error)
+              asprintf (error, "Pattern %s is larger than its header "
+                "says", filename);
+            ret = FALSE;
+            }
+          else
+            {
+            memset (cells + y * w + x, state, n);
+            x += n;
+            }
+          count = 0;
+          }
+        }
+      }
+    }
+  free (line);
+  fclose (f);
+
+  if (ret && !header)
+    {
+    if (error)
+      asprintf (error, "%s is not an RLE file: no valid header", filename);
+    ret = FALSE;
+    }
+
+  if (ret)
+    {
+    int x0 = (life_get_width (life) - w) / 2;
+    int y0 = (life_get_height (life) - h) / 2;
+    life_clear (life);
+    for (int j = 0; j < h; j++)
+      for (int i = 0; i < w; i++)
+        if (cells [j * w + i])
+          life_set_cell (life, x0 + i, y0 + j, cells [j * w + i]);
+    log_debug ("Loaded %d x %d pattern from %s", w, h, filename);
+    }
+
+  free (cells);
+  LOG_OUT
+  return ret;
+  }
+
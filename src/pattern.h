@@ -0,0 +1,20 @@
+/*============================================================================
+
+  fblife
+  pattern.h
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+============================================================================*/
+
+#pragma once
+
+#include "defs.h"
+#include "life.h"
+
+BEGIN_DECLS
+
+BOOL        pattern_load_rle (Life *life, const char *filename,
+              char **error);
+
+END_DECLS
+
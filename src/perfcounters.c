@@ -0,0 +1,291 @@
+/*============================================================================
+
+  fblife
+  perfcounters.c
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  PerfCounters reads the CPU's hardware performance counters -- cycles,
+  instructions, cache misses, and branch misses -- for the calling
+  thread, using perf_event_open(), so that no 'perf' tool is needed.
+  The counters run all the time; perfcounters_begin() and
+  perfcounters_end() read them around a phase of the frame, and add
+  the difference to that phase's totals. perfcounters_report() logs
+  the instructions per cycle and the misses per thousand instructions
+  for each phase: a low IPC with a lot of cache misses means that a
+  phase is waiting for memory, rather than computing.
+
+  Only user-space events are counted, which most systems allow to
+  ordinary users (perf_event_paranoid up to 2). Virtual machines often
+  have no hardware counters at all, in which case perfcounters_create()
+  fails. A counter that can't be opened, when the others can, is just
+  reported as "n/a".
+
+  The counters are opened as a group, so that they are scheduled on to
+  the CPU together. If there are more events than hardware counters,
+  the kernel takes turns, and the counts are scaled up by the fraction
+  of the time that the group was actually counting.
+
+============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "defs.h"
+#include "log.h"
+#include "perfcounters.h"
+
+typedef enum
+  {
+  PERF_EVENT_CYCLES = 0, // The group leader, so it must be opened
+  PERF_EVENT_INSTRUCTIONS,
+  PERF_EVENT_CACHE_MISSES,
+  PERF_EVENT_BRANCH_MISSES,
+  PERF_NEVENTS
+  } PerfEvent;
+
+static const uint64_t perfcounters_configs[PERF_NEVENTS] =
+  {
+  PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+  PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+  };
+
+static const char *perfcounters_phase_names[PERF_NPHASES] =
+  { "Simulation", "Render" };
+
+// Counts, or differences between them
+typedef struct _PerfReading
+  {
+  uint64_t value[PERF_NEVENTS];
+  uint64_t enabled; // nsec that the group was enabled
+  uint64_t running; // nsec that it was actually counting
+  } PerfReading;
+
+struct _PerfCounters
+  {
+  int fd[PERF_NEVENTS]; // -1 if the event can't be counted
+  uint64_t id[PERF_NEVENTS];
+  PerfReading start;
+  PerfReading total[PERF_NPHASES];
+  };
+
+
+/*==========================================================================
+  perfcounters_open
+*==========================================================================*/
+static int perfcounters_open (uint64_t config, int group_fd)
+  {
+  struct perf_event_attr attr;
+  memset (&attr, 0, sizeof (attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof (attr);
+  attr.config = config;
+  attr.disabled = group_fd < 0; // The leader starts the whole group
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID
+    | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall (SYS_perf_event_open, &attr, 0, -1, group_fd,
+    PERF_FLAG_FD_CLOEXEC);
+  }
+
+
+/*==========================================================================
+
+  perfcounters_create
+
+  Start counting, for the calling thread. Returns NULL, and sets
+  error, if the counters can't be opened.
+
+*==========================================================================*/
+PerfCounters *perfcounters_create (char **error)
+  {
+  LOG_IN
+  PerfCounters *self = NULL;
+  int leader = perfcounters_open (perfcounters_configs[0], -1);
+  if (leader >= 0)
+    {
+    self = malloc (sizeof (PerfCounters));
+    memset (self, 0, sizeof (PerfCounters));
+    self->fd[0] = leader;
+    for (int i = 1; i < PERF_NEVENTS; i++)
+      {
+      self->fd[i] = perfcounters_open (perfcounters_configs[i], leader);
+      if (self->fd[i] < 0)
+        log_debug ("Can't count hardware event %d: %s", i,
+          strerror (errno));
+      }
+    for (int i = 0; i < PERF_NEVENTS; i++)
+      if (self->fd[i] >= 0)
+        ioctl (self->fd[i], PERF_EVENT_IOC_ID, &self->id[i]);
+    ioctl (leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl (leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    perfcounters_begin (self);
+    }
+  else if (error)
+    {
+    if (errno == EACCES || errno == EPERM)
+      asprintf (error, "Can't open performance counters: %s "
+        "(see /proc/sys/kernel/perf_event_paranoid)", strerror (errno));
+    else
+      asprintf (error, "Can't open performance counters: %s",
+        errno == ENOENT ? "no hardware counters" : strerror (errno));
+    }
+  LOG_OUT
+  return self;
+  }
+
+
+/*==========================================================================
+  perfcounters_destroy
+*==========================================================================*/
+void perfcounters_destroy (PerfCounters *self)
+  {
+  LOG_IN
+  if (self)
+    {
+    for (int i = PERF_NEVENTS - 1; i >= 0; i--)
+      if (self->fd[i] >= 0) close (self->fd[i]);
+    free (self);
+    }
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+
+  perfcounters_read
+
+  Read the whole group at once. The values come back with their IDs,
+  in no particular order, and without the events that couldn't be
+  opened. Leaves the reading unchanged if the read fails.
+
+*==========================================================================*/
+static void perfcounters_read (const PerfCounters *self,
+       PerfReading *reading)
+  {
+  uint64_t buff[3 + 2 * PERF_NEVENTS];
+  ssize_t n = read (self->fd[0], buff, sizeof (buff));
+  if (n < (ssize_t)(3 * sizeof (uint64_t))) return;
+  uint64_t nr = buff[0];
+  if (nr > PERF_NEVENTS) return;
+  reading->enabled = buff[1];
+  reading->running = buff[2];
+  for (uint64_t j = 0; j < nr; j++)
+    {
+    for (int i = 0; i < PERF_NEVENTS; i++)
+      if (self->fd[i] >= 0 && self->id[i] == buff[4 + 2 * j])
+        reading->value[i] = buff[3 + 2 * j];
+    }
+  }
+
+
+/*==========================================================================
+
+  perfcounters_begin
+
+  Start a phase. Does nothing if self is NULL, as do
+  perfcounters_end() and perfcounters_destroy(), so that callers need
+  not check whether counting is turned on.
+
+*==========================================================================*/
+void perfcounters_begin (PerfCounters *self)
+  {
+  if (self) perfcounters_read (self, &self->start);
+  }
+
+
+/*==========================================================================
+
+  perfcounters_end
+
+  End a phase, adding whatever has been counted since
+  perfcounters_begin() to its totals
+
+*==========================================================================*/
+void perfcounters_end (PerfCounters *self, PerfPhase phase)
+  {
+  if (!self) return;
+  PerfReading now = self->start;
+  perfcounters_read (self, &now);
+  PerfReading *total = &self->total[phase];
+  for (int i = 0; i < PERF_NEVENTS; i++)
+    total->value[i] += now.value[i] - self->start.value[i];
+  total->enabled += now.enabled - self->start.enabled;
+  total->running += now.running - self->start.running;
+  }
+
+
+/*==========================================================================
+
+  perfcounters_merge
+
+  Add other's totals -- from another thread, which must not be using
+  it -- to these, and clear them
+
+*==========================================================================*/
+void perfcounters_merge (PerfCounters *self, PerfCounters *other)
+  {
+  for (int p = 0; p < PERF_NPHASES; p++)
+    {
+    for (int i = 0; i < PERF_NEVENTS; i++)
+      self->total[p].value[i] += other->total[p].value[i];
+    self->total[p].enabled += other->total[p].enabled;
+    self->total[p].running += other->total[p].running;
+    }
+  memset (other->total, 0, sizeof (other->total));
+  }
+
+
+/*==========================================================================
+
+  perfcounters_report
+
+  Log the totals for each phase, averaged over the number of frames
+  they cover, and start again
+
+*==========================================================================*/
+void perfcounters_report (PerfCounters *self, int frames)
+  {
+  LOG_IN
+  for (int p = 0; p < PERF_NPHASES && frames > 0; p++)
+    {
+    const PerfReading *total = &self->total[p];
+    if (total->running == 0)
+      {
+      log_info ("%s: not counted", perfcounters_phase_names[p]);
+      continue;
+      }
+    double scale = (double)total->enabled / total->running;
+    double v[PERF_NEVENTS];
+    for (int i = 0; i < PERF_NEVENTS; i++)
+      v[i] = total->value[i] * scale;
+
+    char ipc[32] = "n/a", cache[32] = "n/a", branch[32] = "n/a";
+    BOOL have_instructions = self->fd[PERF_EVENT_INSTRUCTIONS] >= 0
+      && v[PERF_EVENT_INSTRUCTIONS] > 0;
+    if (have_instructions && v[PERF_EVENT_CYCLES] > 0)
+      snprintf (ipc, sizeof (ipc), "%.2f",
+        v[PERF_EVENT_INSTRUCTIONS] / v[PERF_EVENT_CYCLES]);
+    if (have_instructions && self->fd[PERF_EVENT_CACHE_MISSES] >= 0)
+      snprintf (cache, sizeof (cache), "%.2f",
+        v[PERF_EVENT_CACHE_MISSES] * 1000 / v[PERF_EVENT_INSTRUCTIONS]);
+    if (have_instructions && self->fd[PERF_EVENT_BRANCH_MISSES] >= 0)
+      snprintf (branch, sizeof (branch), "%.2f",
+        v[PERF_EVENT_BRANCH_MISSES] * 1000 / v[PERF_EVENT_INSTRUCTIONS]);
+
+    log_info ("%s: %.2fM cycles/frame, IPC %s, per 1000 instructions: "
+      "%s cache misses, %s branch misses%s", perfcounters_phase_names[p],
+      v[PERF_EVENT_CYCLES] / frames / 1e6, ipc, cache, branch,
+      scale > 1.01 ? " (multiplexed)" : "");
+    }
+  memset (self->total, 0, sizeof (self->total));
+  LOG_OUT
+  }
+
@@ -0,0 +1,35 @@
+/*============================================================================
+
+  fblife
+  perfcounters.h
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+============================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+#include "defs.h"
+
+// The parts of a frame that are counted separately
+typedef enum
+  {
+  PERF_PHASE_SIMULATION = 0, // Working out the next generation
+  PERF_PHASE_RENDER,         // Drawing, and copying to the outputs
+  PERF_NPHASES
+  } PerfPhase;
+
+struct _PerfCounters;
+typedef struct _PerfCounters PerfCounters;
+
+BEGIN_DECLS
+
+PerfCounters *perfcounters_create (char **error);
+void          perfcounters_destroy (PerfCounters *self);
+void          perfcounters_begin (PerfCounters *self);
+void          perfcounters_end (PerfCounters *self, PerfPhase phase);
+void          perfcounters_merge (PerfCounters *self, PerfCounters *other);
+void          perfcounters_report (PerfCounters *self, int frames);
+
+END_DECLS
+
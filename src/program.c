@@ -9,6 +9,7 @@
 
 ==========================================================================*/
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -17,6 +18,8 @@
 #include <time.h>
 #include <signal.h>
 #include <math.h>
+#include <limits.h>
+#include <pthread.h>
 #include "program_context.h" 
 #include "feature.h" 
 #include "program.h" 
@@ -28,6 +31,15 @@
 #include "life.h"
 #include "region.h"
 #include "colour.h"
+#include "metrics.h"
+#include "rule.h"
+#include "panel.h"
+#include "output.h"
+#include "control.h"
+#include "recorder.h"
+#include "image.h"
+#include "perfcounters.h"
+#include "trace.h"
 
 /* Defaults for command-line arguments */
 #define DEF_WIDTH 20 
@@ -43,24 +55,123 @@
 #define DEF_BORDER_COLOUR "cyan"
 #define DEF_B_RULE "3"
 #define DEF_S_RULE "23"
+#define DEF_TOPOLOGY "torus"
+#define DEF_GENERATIONS_PER_FRAME 1
+#define DEF_SCALE 1
+#define DEF_IDLE_THRESHOLD 0
+#define DEF_IDLE_INTERVAL 8000
+#define DEF_SNAPSHOT_GENERATIONS 100
+#define DEF_SNAPSHOT_COUNT 1
+// When idle, the interval is doubled each frame, starting from at
+//   least this many msec
+#define IDLE_MIN_INTERVAL 10
+// How often to check for commands when paused, in msec
+#define PAUSE_INTERVAL 100
+// How often to report the hardware performance counters, in seconds
+#define PERF_REPORT_INTERVAL 10
+
+// Settings that change the layout of the display, or the way the
+//   program is set up; if any of these change when the settings are
+//   reloaded, everything is built again from scratch
+static const char *program_layout_settings[] = 
+  {
+  "panels", "fbdev", "scale", "direct", "control", "metrics", "watch-rc",
+  "record", "record-format", "seed", "pattern", "perf-counters", NULL
+  };
+static const char *program_panel_layout_settings[] = 
+  {
+  "width", "height", "cell-size", "x", "y", "topology", "follow", NULL
+  };
+static const char *program_output_layout_settings[] = 
+  {
+  "x", "y", "scale", NULL
+  };
+
+// The settings that can be changed while running, by the 'set' command
+static const char *program_live_settings[] = 
+  {
+  "interval", "idle-threshold", "idle-interval", "percent", "max-cycles",
+  "generations-per-frame", "colour", "border-colour", "rule", "b-rule",
+  "s-rule", NULL
+  };
+
+/*==========================================================================
+
+  program_get_rule
+
+  Build the rule from the "rule" setting if there is one, or from
+  "b-rule" and "s-rule" if not. Returns NULL, and sets error, if the
+  rule is invalid.
+
+==========================================================================*/
+Rule *program_get_rule (const ProgramContext *context, char **error)
+  {
+  LOG_IN
+  Rule *ret = NULL;
+  const char *rule = program_context_get (context, "rule");
+  if (rule)
+    ret = rule_parse (rule, error);
+  else
+    {
+    const char *b_rule = program_context_get (context, "b-rule");
+    if (b_rule == NULL) b_rule = DEF_B_RULE;
+    const char *s_rule = program_context_get (context, "s-rule");
+    if (s_rule == NULL) s_rule = DEF_S_RULE;
+    char *s;
+    asprintf (&s, "B%s/S%s", b_rule, s_rule);
+    ret = rule_parse (s, error);
+    free (s);
+    }
+  LOG_OUT
+  return ret;
+  }
+
+/*==========================================================================
+
+  program_get_region_width
+
+  The width in pixels of the display region. In a hexagonal grid, 
+  alternate rows are offset by half a cell, so the region needs to be
+  half a cell wider
+
+==========================================================================*/
+int program_get_region_width (const ProgramContext *context)
+  {
+  LOG_IN
+  int width = program_context_get_integer (context, "width", DEF_WIDTH);
+  int cell_size = program_context_get_integer (context, "cell-size", 
+           DEF_CELL_SIZE);
+  int ret = width * cell_size;
+  Rule *rule = program_get_rule (context, NULL);
+  if (rule)
+    {
+    if (rule_get_family (rule) == RULE_FAMILY_HEX) 
+      ret += cell_size / 2;
+    rule_destroy (rule);
+    }
+  LOG_OUT
+  return ret;
+  }
 
 /*==========================================================================
 
   program_check_context
 
+  Check the settings. If fb is NULL, as when taking a snapshot, the
+  checks that the display fits on the screen are left out.
+
 ==========================================================================*/
 BOOL program_check_context (const ProgramContext *context, 
       const FrameBuffer *fb)
   {
   LOG_IN
   BOOL ret = TRUE;
-  int fb_w = framebuffer_get_width (fb);
-  int fb_h = framebuffer_get_height (fb);
-  int width = program_context_get_integer (context, "width", DEF_WIDTH);
+  int fb_w = fb ? framebuffer_get_width (fb) : 0;
+  int fb_h = fb ? framebuffer_get_height (fb) : 0;
   int height = program_context_get_integer (context, "height", DEF_HEIGHT);
   int cell_size = program_context_get_integer (context, "cell-size", 
            DEF_CELL_SIZE);
-  int region_width = width * cell_size;
+  int region_width = program_get_region_width (context);
   int region_height = height * cell_size;
   int x = program_context_get_integer (context, "x", DEF_X);
   int y = program_context_get_integer (context, "y", DEF_Y);
@@ -70,9 +181,9 @@ BOOL program_check_context (const ProgramContext *context,
   if (border_colour == NULL) border_colour = DEF_BORDER_COLOUR;
 
   if (x < 0)
-    x = (framebuffer_get_width (fb) - region_width) / 2; 
+    x = (fb_w - region_width) / 2; 
   if (y < 0)
-    y = (framebuffer_get_height (fb) - region_height) / 2; 
+    y = (fb_h - region_height) / 2; 
   if (ret)
     {
     BYTE r, g, b;
@@ -98,6 +209,66 @@ BOOL program_check_context (const ProgramContext *context,
       }
     }
   if (ret)
+    {
+    char *error = NULL;
+    Rule *rule = program_get_rule (context, &error);
+    if (rule)
+      rule_destroy (rule);
+    else
+      {
+      log_error ("Bad rule: %s", error);
+      free (error);
+      ret = FALSE;
+      }
+    }
+  if (ret)
+    {
+    if (program_context_get_integer (context, "generations-per-frame", 
+          DEF_GENERATIONS_PER_FRAME) < 1)
+      {
+      log_error ("Generations per frame must be at least 1");
+      ret = FALSE;
+      }
+    }
+  if (ret)
+    {
+    const char *format = program_context_get (context, "record-format");
+    RecorderFormat f;
+    if (format && !recorder_parse_format (format, &f))
+      {
+      log_error ("Unknown recording format: %s", format);
+      ret = FALSE;
+      }
+    }
+  if (ret)
+    {
+    if (program_context_get_integer (context, "interval", 
+          DEF_INTERVAL) < 0)
+      {
+      log_error ("Interval must not be negative");
+      ret = FALSE;
+      }
+    }
+  if (ret)
+    {
+    if (program_context_get_integer (context, "idle-threshold", 
+          DEF_IDLE_THRESHOLD) < 0)
+      {
+      log_error ("Idle threshold must not be negative");
+      ret = FALSE;
+      }
+    }
+  if (ret)
+    {
+    const char *topology = program_context_get (context, "topology");
+    LifeTopology t;
+    if (topology && !life_parse_topology (topology, &t))
+      {
+      log_error ("Unknown topology: %s", topology);
+      ret = FALSE;
+      }
+    }
+  if (ret && fb)
     {
     if (region_width > fb_w)
       {
@@ -106,7 +277,7 @@ BOOL program_check_context (const ProgramContext *context,
       ret = FALSE;
       }
     }
-  if (ret)
+  if (ret && fb)
     {
     if (region_height > fb_h)
       {
@@ -115,7 +286,7 @@ BOOL program_check_context (const ProgramContext *context,
       ret = FALSE;
       }
     }
-  if (ret)
+  if (ret && fb)
     {
     if (region_width + x > fb_w || region_height + y > fb_h
          || x < 0 || y < 0)
@@ -132,191 +303,1326 @@ BOOL program_check_context (const ProgramContext *context,
 
 /*======================================================================
   program_quit_signal 
-  In response to a quit, or interrupt, we must unexport any pins that
-  we exported
+  In response to a quit, or interrupt, we just set a flag. The main
+  loop checks it once per cycle, and tidies up -- restoring the cursor,
+  removing the shared memory metrics segment, etc.
 ======================================================================*/
+static volatile sig_atomic_t program_quit = FALSE;
+
 void program_quit_signal (int dummy)
   {
-  // Show the cursor
-  fputs ("\e[?25h", stdout); 
-  fflush (stdout);
-  exit (0);
+  program_quit = TRUE;
   }
 
 
-/*==========================================================================
+/*======================================================================
+  program_reload_signal 
+  SIGHUP asks for the settings to be read again. Again, we just set a
+  flag, and the main loop does the work between frames.
+======================================================================*/
+static volatile sig_atomic_t program_reload = FALSE;
 
-  erase_region_background 
+void program_reload_signal (int dummy)
+  {
+  program_reload = TRUE;
+  }
 
-==========================================================================*/
-void erase_region_background (Region *region)
+
+/*======================================================================
+  program_trace_signal 
+  SIGUSR1 asks for the trace to be written, which the main loop does
+  between frames.
+======================================================================*/
+static volatile sig_atomic_t program_dump_trace = FALSE;
+
+void program_trace_signal (int dummy)
+  {
+  program_dump_trace = TRUE;
+  }
+
+
+/*======================================================================
+  program_write_trace 
+  Write the trace to the file given by the "trace" setting, if 
+  tracing is on
+======================================================================*/
+static void program_write_trace (const ProgramContext *context)
+  {
+  const char *filename = program_context_get (context, "trace");
+  if (trace_enabled && filename)
+    {
+    char *error = NULL;
+    if (trace_write (filename, &error))
+      log_info ("Wrote trace to %s", filename);
+    else
+      {
+      log_warning (error);
+      free (error);
+      }
+    }
+  }
+
+
+/*======================================================================
+  program_now_usec 
+======================================================================*/
+static int64_t program_now_usec (void)
   {
-  region_fill_rect (region, 0, 0, region_get_width (region),
-    region_get_height (region), 0, 0, 0);
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
   }
 
 
 /*==========================================================================
 
-  draw_life_on_region 
+  program_create_panel 
+
+  Create a Panel, and the Life in it, from the settings in the context.
+  The context should already have been checked by program_check_context.
+  If fb is NULL, the panel is placed at 0,0 unless x and y are set.
 
 ==========================================================================*/
-void draw_life_on_region (Region *region, const Life *life, int cell_size,
-       BYTE red, BYTE green, BYTE blue,  
-       BYTE red_border, BYTE green_border, BYTE blue_border)
+static Panel *program_create_panel (const ProgramContext *context, 
+       const FrameBuffer *fb)
   {
   LOG_IN
-  int w = life_get_width (life);
-  int h = life_get_height (life);
+  int width = program_context_get_integer (context, "width", DEF_WIDTH);
+  int height = program_context_get_integer (context, "height", DEF_HEIGHT);
+  int cell_size = program_context_get_integer (context, "cell-size", 
+       DEF_CELL_SIZE);
+  int region_width = program_get_region_width (context);
+  int region_height = height * cell_size;
+  int x = program_context_get_integer (context, "x", DEF_X);
+  int y = program_context_get_integer (context, "y", DEF_Y);
+  int percent = program_context_get_integer 
+        (context, "percent", DEF_PERCENT);
+  int max_cycles = program_context_get_integer 
+        (context, "max-cycles", DEF_MAX_CYCLES);
+  int generations_per_frame = program_context_get_integer 
+        (context, "generations-per-frame", DEF_GENERATIONS_PER_FRAME);
+  const char *colour = program_context_get (context, "colour");
+  if (colour == NULL) colour = DEF_COLOUR;
+  BYTE r, g, b;
+  colour_parse (colour, &r, &g, &b);
+  const char *border_colour = program_context_get 
+     (context, "border-colour");
+  if (border_colour == NULL) border_colour = DEF_BORDER_COLOUR;
+  BYTE rb, gb, bb;
+  colour_parse (border_colour, &rb, &gb, &bb);
+  Rule *rule = program_get_rule (context, NULL);
+  const char *topology_name = program_context_get (context, "topology");
+  if (topology_name == NULL) topology_name = DEF_TOPOLOGY;
+  LifeTopology topology;
+  life_parse_topology (topology_name, &topology);
+
+  if (x < 0)
+    x = fb ? (framebuffer_get_width (fb) - region_width) / 2 : 0; 
+  if (y < 0)
+    y = fb ? (framebuffer_get_height (fb) - region_height) / 2 : 0; 
+
+  log_debug ("Display region is %d x %d", region_width, region_height);
+  log_debug ("TL corner is %d x %d", x, y); 
+  log_debug ("Percent coverage is %d", percent); 
+  log_debug ("Maximum cycles is %d", max_cycles); 
+  log_debug ("Generations per frame is %d", generations_per_frame); 
+  log_debug ("Rule is %s", rule_get_name (rule)); 
+  log_debug ("Topology is %s", topology_name); 
+
+  Life *life = life_create (width, height, rule, topology);
+  life_set_follow (life, program_context_get_boolean 
+    (context, "follow", FALSE));
+  rule_destroy (rule);
+
+  Panel *ret = panel_create (life, x, y, cell_size, r, g, b, rb, gb, bb,
+    percent, max_cycles, generations_per_frame);
+  LOG_OUT
+  return ret;
+  }
+
+/*==========================================================================
+
+  program_open_framebuffers
 
-  erase_region_background (region);
+  Open the framebuffers in the comma-separated list 'fbdevs'. Returns 
+  the number opened, or zero, having reported the error, if any of 
+  them could not be opened. 
 
-  for (int row = 0; row < h; row++)
+==========================================================================*/
+static int program_open_framebuffers (const char *fbdevs, 
+       FrameBuffer ***fbs)
+  {
+  LOG_IN
+  int n = 0;
+  *fbs = NULL;
+  char *devs = strdup (fbdevs);
+  char *saveptr = NULL;
+  BOOL ok = TRUE;
+  for (char *dev = strtok_r (devs, ",", &saveptr); dev && ok; 
+       dev = strtok_r (NULL, ",", &saveptr))
     {
-    int y = row * cell_size;
-    for (int col = 0; col < w; col++)
+    FrameBuffer *fb = framebuffer_create (dev);
+    char *error = NULL;
+    framebuffer_init (fb, &error);
+    if (error == NULL)
       {
-      int x = col * cell_size;
-
-      int state = life_get_state (life, col, row);
-      if (state)
-        {
-        region_draw_rect (region, x, y, x + cell_size - 2, 
-          y + cell_size - 2, red_border, green_border, blue_border); 
-        region_fill_rect (region, x + 1, y + 1, x + cell_size - 3, 
-          y + cell_size - 3, red, green, blue); 
-        }
+      *fbs = realloc (*fbs, (n + 1) * sizeof (FrameBuffer *));
+      (*fbs)[n++] = fb;
+      }
+    else
+      {
+      log_error ("%s: %s", dev, error);
+      free (error);
+      framebuffer_destroy (fb);
+      ok = FALSE;
+      }
+    }
+  free (devs);
+  if (!ok)
+    {
+    for (int i = 0; i < n; i++)
+      {
+      framebuffer_deinit ((*fbs)[i]);
+      framebuffer_destroy ((*fbs)[i]);
       }
+    free (*fbs);
+    *fbs = NULL;
+    n = 0;
     }
+  LOG_OUT
+  return n;
+  }
+
+/*==========================================================================
+
+  program_create_outputs
 
+  Create an Output for each framebuffer. Each is magnified by the
+  "scale" setting, unless "output.N.scale" says otherwise (N counting
+  from 1). The frame is drawn at (x,y) on the first framebuffer -- the
+  positions of the panels -- if it is not magnified. Otherwise, and on
+  the others, it is centred, unless "output.N.x" and "output.N.y" say 
+  otherwise. With more than one output, each has its own thread. 
+  Returns NULL, having reported the error, if the frame would not fit
+  on one of the framebuffers. Otherwise, the outputs take ownership of
+  the framebuffers.
+
+==========================================================================*/
+static Output **program_create_outputs (const ProgramContext *context, 
+       FrameBuffer **fbs, int nfbs, int x, int y, int w, int h)
+  {
   LOG_IN
+  Output **outputs = NULL;
+  int *ox = malloc (nfbs * sizeof (int));
+  int *oy = malloc (nfbs * sizeof (int));
+  int *scale = malloc (nfbs * sizeof (int));
+  BOOL ok = TRUE;
+  for (int i = 0; i < nfbs && ok; i++)
+    {
+    char key[32];
+    int fb_w = framebuffer_get_width (fbs[i]);
+    int fb_h = framebuffer_get_height (fbs[i]);
+    snprintf (key, sizeof (key), "output.%d.scale", i + 1);
+    scale[i] = program_context_get_integer (context, key, 
+      program_context_get_integer (context, "scale", DEF_SCALE));
+    if (scale[i] < 1)
+      {
+      log_error ("Scale must be at least 1 on output %d", i + 1);
+      ok = FALSE;
+      break;
+      }
+    int sw = w * scale[i], sh = h * scale[i];
+    BOOL centre = (i > 0 || scale[i] > 1);
+    snprintf (key, sizeof (key), "output.%d.x", i + 1);
+    ox[i] = program_context_get_integer (context, key, 
+      centre ? (fb_w - sw) / 2 : x);
+    snprintf (key, sizeof (key), "output.%d.y", i + 1);
+    oy[i] = program_context_get_integer (context, key, 
+      centre ? (fb_h - sh) / 2 : y);
+    if (ox[i] < 0 || oy[i] < 0 || ox[i] + sw > fb_w || oy[i] + sh > fb_h)
+      {
+      log_error ("Display region lies partly outside the screen "
+        "on output %d", i + 1);
+      ok = FALSE;
+      }
+    }
+  if (ok)
+    {
+    outputs = malloc (nfbs * sizeof (Output *));
+    for (int i = 0; i < nfbs; i++)
+      {
+      log_debug ("Output %d is at %d,%d, scale %d", i + 1, ox[i], oy[i],
+        scale[i]);
+      outputs[i] = output_create (fbs[i], ox[i], oy[i], scale[i], 
+        nfbs > 1);
+      }
+    }
+  free (ox);
+  free (oy);
+  free (scale);
+  LOG_OUT
+  return outputs;
   }
 
 /*==========================================================================
 
-  program_run
+  program_panel_worker 
+
+  When there is more than one panel, each has a worker thread that
+  steps and draws it. The main loop and the workers keep in step using
+  a barrier: each frame, everybody waits at the barrier once to start
+  the work, and again when the work is done. The main loop can then 
+  copy the panels' regions to the screen, while the workers wait at
+  the barrier for the next frame.
+
+  Performance counters only count the thread that opens them, so if
+  they are wanted, each worker has its own, which the main loop adds
+  to its totals while the worker is waiting.
 
 ==========================================================================*/
-int program_run (ProgramContext *context)
+typedef struct _ProgramWorker
   {
-  log_set_level (program_context_get_integer (context, "log-level", 
-      LOG_WARNING));
-  const char *fbdev = "/dev/fb0";
-  const char *arg_fbdev = program_context_get (context, "fbdev");
-  if (arg_fbdev) fbdev = arg_fbdev;
+  pthread_t thread;
+  Panel *panel;
+  pthread_barrier_t *barrier;
+  const BOOL *stop; // Set by the main loop, to end the thread 
+  int index; // From 1, for naming the thread
+  BOOL count; // Open performance counters
+  PerfCounters *perf; // NULL if not counting
+  } ProgramWorker;
 
-  FrameBuffer *fb = framebuffer_create (fbdev);
-  char *error = NULL;
-  framebuffer_init (fb, &error);
-  if (error == NULL)
+static void *program_panel_worker (void *arg)
+  {
+  ProgramWorker *worker = arg;
+  char name[32];
+  snprintf (name, sizeof (name), "panel %d", worker->index);
+  TRACE_THREAD_NAME (name);
+  worker->perf = worker->count ? perfcounters_create (NULL) : NULL;
+  for (;;)
     {
-    if (program_check_context (context, fb))
-      {
-      BOOL erase = program_context_get_boolean (context, "erase", FALSE);
-      int width = program_context_get_integer (context, "width", DEF_WIDTH);
-      int height = program_context_get_integer (context, "height", DEF_HEIGHT);
-      int cell_size = program_context_get_integer (context, "cell-size", 
-           DEF_CELL_SIZE);
-      int region_width = width * cell_size;
-      int region_height = height * cell_size;
-      int x = program_context_get_integer (context, "x", DEF_X);
-      int y = program_context_get_integer (context, "y", DEF_Y);
-      int percent = program_context_get_integer 
-            (context, "percent", DEF_PERCENT);
-      int max_cycles = program_context_get_integer 
-            (context, "max-cycles", DEF_MAX_CYCLES);
-      int interval = program_context_get_integer 
-            (context, "interval", DEF_INTERVAL);
-      int usecs = interval * 1000;
-      const char *colour = program_context_get (context, "colour");
-      if (colour == NULL) colour = DEF_COLOUR;
-      BYTE r, g, b;
-      colour_parse (colour, &r, &g, &b);
-      const char *b_rule = program_context_get (context, "b-rule");
-      if (b_rule == NULL) b_rule = DEF_B_RULE;
-      const char *s_rule = program_context_get (context, "s-rule");
-      if (s_rule == NULL) s_rule = DEF_S_RULE;
-
-      const char *border_colour = program_context_get 
-         (context, "border-colour");
-      if (border_colour == NULL) border_colour = DEF_BORDER_COLOUR;
-      BYTE rb, gb, bb;
-      colour_parse (border_colour, &rb, &gb, &bb);
-
-      if (x < 0)
-        x = (framebuffer_get_width (fb) - region_width) / 2; 
-      if (y < 0)
-        y = (framebuffer_get_height (fb) - region_height) / 2; 
-
-      signal (SIGQUIT, program_quit_signal);
-      signal (SIGTERM, program_quit_signal);
-      signal (SIGHUP, program_quit_signal);
-      signal (SIGINT, program_quit_signal);
-      srand (time (NULL));
-      
-      // Hide cursor
-      fputs("\e[?25l", stdout);
-      fflush (stdout);
-
-      log_debug ("Display region is %d x %d", region_width, region_height);
-      log_debug ("TL corner is %d x %d", x, y); 
-      log_debug ("Percent coverage is %d", percent); 
-      log_debug ("Maximum cycles is %d", max_cycles); 
-
-      Life *life = life_create (width, height, b_rule, s_rule);
-      life_seed (life, percent); 
-
-      if (erase) framebuffer_clear (fb);
-
-      Region *region = region_create (region_width, region_height);
-
-      int cycle = 1;
-      while (TRUE)
-        {
-        log_debug ("Starting cycle %d", cycle); 
-        draw_life_on_region (region, life, cell_size, r, g, b,
-           rb, gb, bb);
-        region_to_fb (region, fb, x, y); 
-        usleep (usecs); 
-        if (cycle >= max_cycles)
-          {
-          log_debug ("Restarting with new seed");
-          life_seed (life, percent); 
-          cycle = 0;
-          }
-         else
-          {
-          BOOL viable = life_update (life);
-          if (!viable)
-            {
-            log_debug ("Restarting with new seed");
-            life_seed (life, percent); 
-            cycle = 0;
-            }
-          }
-        cycle++;
-        }
+    pthread_barrier_wait (worker->barrier);
+    if (*worker->stop) break;
+    perfcounters_begin (worker->perf);
+    panel_draw (worker->panel);
+    perfcounters_end (worker->perf, PERF_PHASE_RENDER);
+    perfcounters_begin (worker->perf);
+    panel_step (worker->panel);
+    perfcounters_end (worker->perf, PERF_PHASE_SIMULATION);
+    pthread_barrier_wait (worker->barrier);
+    }
+  perfcounters_destroy (worker->perf);
+  return NULL;
+  }
+
+/*==========================================================================
+
+  program_get_timing
+
+  Get the interval between frames, and the idle settings, in usec
+
+==========================================================================*/
+static void program_get_timing (const ProgramContext *context, int *usecs,
+       int *idle_threshold, int *idle_usecs)
+  {
+  *usecs = program_context_get_integer 
+        (context, "interval", DEF_INTERVAL) * 1000;
+  *idle_threshold = program_context_get_integer 
+        (context, "idle-threshold", DEF_IDLE_THRESHOLD);
+  *idle_usecs = program_context_get_integer 
+        (context, "idle-interval", DEF_IDLE_INTERVAL) * 1000;
+  if (*idle_usecs < *usecs) *idle_usecs = *usecs;
+  }
+
+/*==========================================================================
+
+  program_configure_panels
+
+  Apply the settings in program_live_settings to the running panels, 
+  each from its own view of the context (so "panel.N.xxx" settings 
+  still take precedence). The settings should already have been 
+  checked. Returns FALSE, and sets error, if a panel can't take the 
+  new rule.
 
-      life_destroy (life);
-      region_destroy (region);
-      // Show the cursor
-      printf("\e[?25h"); 
-      fflush (stdout);
+==========================================================================*/
+static BOOL program_configure_panels (const ProgramContext *context,
+       Panel **panels, int npanels, char **error)
+  {
+  LOG_IN
+  BOOL ret = TRUE;
+  for (int i = 0; i < npanels && ret; i++)
+    {
+    ProgramContext *pc = program_context_create_panel (context, i + 1);
+    const char *colour = program_context_get (pc, "colour");
+    if (colour == NULL) colour = DEF_COLOUR;
+    BYTE r, g, b;
+    colour_parse (colour, &r, &g, &b);
+    const char *border_colour = program_context_get (pc, "border-colour");
+    if (border_colour == NULL) border_colour = DEF_BORDER_COLOUR;
+    BYTE rb, gb, bb;
+    colour_parse (border_colour, &rb, &gb, &bb);
+
+    panel_set_options (panels[i],
+      program_context_get_integer (pc, "percent", DEF_PERCENT),
+      program_context_get_integer (pc, "max-cycles", DEF_MAX_CYCLES),
+      program_context_get_integer (pc, "generations-per-frame", 
+        DEF_GENERATIONS_PER_FRAME));
+    panel_set_colours (panels[i], r, g, b, rb, gb, bb);
+
+    Rule *rule = program_get_rule (pc, NULL);
+    const Rule *old_rule = life_get_rule (panel_get_life (panels[i]));
+    if (strcmp (rule_get_name (rule), rule_get_name (old_rule)) != 0)
+      {
+      log_info ("Panel %d rule changed to %s", i + 1, 
+        rule_get_name (rule));
+      ret = panel_set_rule (panels[i], rule, error);
       }
-    else
+    rule_destroy (rule);
+    program_context_destroy (pc);
+    }
+  LOG_OUT
+  return ret;
+  }
+
+/*==========================================================================
+
+  program_is_live_setting
+
+  Whether the setting can be changed while running -- either one of
+  program_live_settings, or one of those prefixed with "panel.N."
+
+==========================================================================*/
+static BOOL program_is_live_setting (const char *key)
+  {
+  int panel, n = 0;
+  if (sscanf (key, "panel.%d.%n", &panel, &n) == 1 && n > 0)
+    key += n;
+  for (int i = 0; program_live_settings[i]; i++)
+    if (strcmp (key, program_live_settings[i]) == 0) return TRUE;
+  return FALSE;
+  }
+
+/*==========================================================================
+
+  program_set
+
+  Handle the 'set' command: change a setting in the context, check that
+  all the panels are happy with it, and apply it. If not, the old value
+  is restored. Returns FALSE, and sets error, if the change could not
+  be made.
+
+==========================================================================*/
+static BOOL program_set (ProgramContext *context, const char *key,
+       const char *value, Panel **panels, int npanels, 
+       const FrameBuffer *fb, char **error)
+  {
+  LOG_IN
+  BOOL ret = TRUE;
+  if (!program_is_live_setting (key))
+    {
+    asprintf (error, "%s can't be changed while running", key);
+    LOG_OUT
+    return FALSE;
+    }
+
+  const char *old = program_context_get (context, key);
+  char *old_value = old ? strdup (old) : NULL;
+  program_context_put (context, key, value);
+  for (int i = 0; i < npanels && ret; i++)
+    {
+    ProgramContext *pc = program_context_create_panel (context, i + 1);
+    if (!program_check_context (pc, fb))
       {
-      // Do nothing -- error already reported
+      asprintf (error, "Invalid value for %s: %s", key, value);
+      ret = FALSE;
       }
-    framebuffer_deinit (fb);
-    framebuffer_destroy (fb);
-    
+    program_context_destroy (pc);
     }
-  else
+  if (ret)
+    ret = program_configure_panels (context, panels, npanels, error);
+
+  if (!ret)
     {
-    log_error (error);
-    free (error);
+    if (old_value)
+      program_context_put (context, key, old_value);
+    else
+      program_context_delete (context, key);
+    program_configure_panels (context, panels, npanels, NULL);
     }
+  free (old_value);
+  LOG_OUT
+  return ret;
+  }
+
+/*==========================================================================
+
+  program_do_command
 
-  return 0;
+  Carry out a command from the control socket, and reply to it. The 
+  commands are:
+
+  stats -- report the metrics
+  pause, resume -- stop and start the simulation
+  reseed -- start all the panels from new random seeds
+  load FILE -- start all the panels from a pattern in an RLE file
+  get KEY -- report a setting
+  set KEY VALUE -- change one of program_live_settings
+
+  The reply is a single line starting "OK" or "ERROR". Sets *retime
+  if the timing settings might have changed.
+
+==========================================================================*/
+static void program_do_command (ProgramContext *context, Control *control,
+       int client, const char *command, Panel **panels, int npanels, 
+       const FrameBuffer *fb, Metrics *metrics, BOOL *paused, BOOL *retime)
+  {
+  LOG_IN
+  log_debug ("Control command: %s", command);
+  char *s = strdup (command);
+  char *saveptr = NULL;
+  const char *verb = strtok_r (s, " \t", &saveptr);
+  const char *arg1 = strtok_r (NULL, " \t", &saveptr);
+  const char *arg2 = strtok_r (NULL, "", &saveptr);
+  if (arg2) 
+    while (*arg2 == ' ' || *arg2 == '\t') arg2++;
+  char *error = NULL;
+
+  if (verb == NULL)
+    {
+    // Can't happen -- Control does not pass on empty lines
+    }
+  else if (strcmp (verb, "stats") == 0)
+    {
+    MetricsData data;
+    if (metrics_read (metrics, &data))
+      control_reply (control, client, "OK generation=%llu cycle=%llu "
+        "population=%llu reseeds=%llu frames=%llu gens-per-sec=%.1f "
+        "paused=%s", (unsigned long long)data.generation, 
+        (unsigned long long)data.cycle, 
+        (unsigned long long)data.population, 
+        (unsigned long long)data.reseeds, 
+        (unsigned long long)data.frames, data.gens_per_sec, 
+        *paused ? "yes" : "no");
+    else
+      control_reply (control, client, "ERROR Metrics are busy");
+    }
+  else if (strcmp (verb, "pause") == 0)
+    {
+    *paused = TRUE;
+    control_reply (control, client, "OK");
+    }
+  else if (strcmp (verb, "resume") == 0)
+    {
+    *paused = FALSE;
+    control_reply (control, client, "OK");
+    }
+  else if (strcmp (verb, "reseed") == 0)
+    {
+    for (int i = 0; i < npanels; i++)
+      {
+      panel_reseed (panels[i]);
+      metrics_add_reseed (metrics);
+      }
+    control_reply (control, client, "OK");
+    }
+  else if (strcmp (verb, "load") == 0 && arg1)
+    {
+    BOOL ok = TRUE;
+    for (int i = 0; i < npanels && ok; i++)
+      ok = panel_load (panels[i], arg1, &error);
+    if (ok)
+      control_reply (control, client, "OK");
+    }
+  else if (strcmp (verb, "get") == 0 && arg1)
+    {
+    const char *value = program_context_get (context, arg1);
+    if (value)
+      control_reply (control, client, "OK %s", value);
+    else
+      control_reply (control, client, "ERROR %s is not set", arg1);
+    }
+  else if (strcmp (verb, "set") == 0 && arg1 && arg2 && *arg2)
+    {
+    if (program_set (context, arg1, arg2, panels, npanels, fb, &error))
+      {
+      control_reply (control, client, "OK");
+      *retime = TRUE;
+      }
+    }
+  else
+    control_reply (control, client, "ERROR Unknown command, or missing "
+      "argument: %s", command);
+
+  if (error)
+    {
+    control_reply (control, client, "ERROR %s", error);
+    free (error);
+    }
+  free (s);
+  LOG_OUT
+  }
+
+/*==========================================================================
+
+  program_create_recorder
+
+  Start recording, if the "record" setting says so. The format is
+  given by "record-format" or, failing that, by the extension of the
+  file. The nominal frame rate is one frame per interval. Returns NULL,
+  having reported the error, if recording can't be started, or if it
+  was not asked for.
+
+==========================================================================*/
+static Recorder *program_create_recorder (const ProgramContext *context)
+  {
+  LOG_IN
+  Recorder *ret = NULL;
+  const char *path = program_context_get (context, "record");
+  if (path)
+    {
+    RecorderFormat format = RECORDER_FORMAT_RGB;
+    const char *format_name = program_context_get (context, 
+      "record-format");
+    const char *ext = strrchr (path, '.');
+    if (format_name)
+      recorder_parse_format (format_name, &format);
+    else if (ext && strcasecmp (ext, ".y4m") == 0)
+      format = RECORDER_FORMAT_Y4M;
+
+    int interval = program_context_get_integer (context, "interval", 
+      DEF_INTERVAL);
+    int fps_num = 1000, fps_den = interval;
+    if (interval <= 0)
+      {
+      fps_num = 25; // Any rate will do: the frames are not timed 
+      fps_den = 1;
+      }
+    for (int d = fps_den; d > 1; d--)
+      {
+      if (fps_num % d == 0 && fps_den % d == 0)
+        {
+        fps_num /= d;
+        fps_den /= d;
+        break;
+        }
+      }
+
+    char *error = NULL;
+    ret = recorder_create (path, format, fps_num, fps_den, &error);
+    if (ret == NULL)
+      {
+      log_error (error);
+      free (error);
+      }
+    }
+  LOG_OUT
+  return ret;
+  }
+
+/*==========================================================================
+
+  program_setting_changed
+
+  Whether the setting 'key' is different in the two contexts
+
+==========================================================================*/
+static BOOL program_setting_changed (const ProgramContext *c1, 
+       const ProgramContext *c2, const char *key)
+  {
+  const char *v1 = program_context_get (c1, key);
+  const char *v2 = program_context_get (c2, key);
+  if (v1 == NULL || v2 == NULL) return v1 != v2;
+  return strcmp (v1, v2) != 0;
+  }
+
+/*==========================================================================
+
+  program_layout_changed
+
+  Whether the change from old settings to new would change anything 
+  in program_layout_settings, program_panel_layout_settings for any 
+  panel, program_output_layout_settings for any output, or whether any
+  panel's rule would change to or from a hexagonal one.
+
+==========================================================================*/
+static BOOL program_layout_changed (const ProgramContext *before, 
+       const ProgramContext *after, int npanels, int noutputs)
+  {
+  LOG_IN
+  BOOL ret = FALSE;
+  for (int i = 0; program_layout_settings[i] && !ret; i++)
+    ret = program_setting_changed (before, after, 
+      program_layout_settings[i]);
+
+  for (int p = 0; p < npanels && !ret; p++)
+    {
+    ProgramContext *old_pc = program_context_create_panel (before, p + 1);
+    ProgramContext *new_pc = program_context_create_panel (after, p + 1);
+    for (int i = 0; program_panel_layout_settings[i] && !ret; i++)
+      ret = program_setting_changed (old_pc, new_pc, 
+        program_panel_layout_settings[i]);
+    if (!ret)
+      {
+      Rule *old_rule = program_get_rule (old_pc, NULL);
+      Rule *new_rule = program_get_rule (new_pc, NULL);
+      ret = ((rule_get_family (old_rule) == RULE_FAMILY_HEX) 
+        != (rule_get_family (new_rule) == RULE_FAMILY_HEX));
+      rule_destroy (old_rule);
+      rule_destroy (new_rule);
+      }
+    program_context_destroy (old_pc);
+    program_context_destroy (new_pc);
+    }
+
+  for (int o = 0; o < noutputs && !ret; o++)
+    {
+    for (int i = 0; program_output_layout_settings[i] && !ret; i++)
+      {
+      char key[32];
+      snprintf (key, sizeof (key), "output.%d.%s", o + 1, 
+        program_output_layout_settings[i]);
+      ret = program_setting_changed (before, after, key);
+      }
+    }
+  LOG_OUT
+  return ret;
+  }
+
+/*==========================================================================
+
+  program_reload_settings
+
+  Read the RC files and the command line again, and apply the new 
+  settings. If they are not valid, they are ignored, and the program
+  carries on as it was. If they would change the layout -- see 
+  program_layout_changed -- the context is updated, and TRUE returned,
+  so that the caller can build everything again. Otherwise, the new
+  settings are applied to the running panels in one go.
+
+==========================================================================*/
+static BOOL program_reload_settings (ProgramContext *context, 
+       Panel **panels, int npanels, int noutputs, const FrameBuffer *fb)
+  {
+  LOG_IN
+  BOOL ret = FALSE;
+  log_info ("Reloading settings");
+  ProgramContext *reread = program_context_reread (context);
+  BOOL ok = (reread != NULL);
+  int new_npanels = 
+    ok ? program_context_get_integer (reread, "panels", 1) : 0;
+  for (int i = 0; i < new_npanels && ok; i++)
+    {
+    ProgramContext *pc = program_context_create_panel (reread, i + 1);
+    ok = program_check_context (pc, fb);
+    program_context_destroy (pc);
+    }
+
+  if (!ok)
+    {
+    log_error ("New settings are not valid, and have been ignored");
+    program_context_destroy (reread);
+    }
+  else if (program_layout_changed (context, reread, npanels, noutputs))
+    {
+    log_info ("Layout has changed -- starting again");
+    program_context_replace (context, reread);
+    ret = TRUE;
+    }
+  else
+    {
+    program_context_replace (context, reread);
+    log_set_level (program_context_get_integer (context, "log-level", 
+      LOG_WARNING));
+    char *error = NULL;
+    if (!program_configure_panels (context, panels, npanels, &error))
+      {
+      // Can't happen -- program_layout_changed checks for the only
+      //   change that panels can't take
+      log_error (error);
+      free (error);
+      }
+    }
+  LOG_OUT
+  return ret;
+  }
+
+/*==========================================================================
+
+  program_main_loop
+
+  Run the panels, sending each frame to all the outputs, until told to 
+  quit. *composite is NULL if there is only one panel; otherwise it is 
+  where the panels are assembled, and its top-left is at (cx, cy) on 
+  the screen. When recording, the panels are assembled in a different
+  region each frame, so *composite may change. If there is a control
+  socket, commands from it are carried out between frames, as is
+  reloading the settings. Returns TRUE if the new settings need
+  everything to be set up again.
+
+  With "perf-counters", the hardware performance counters are read
+  around the simulation and render phases of each frame, and the
+  totals are logged every PERF_REPORT_INTERVAL seconds.
+
+==========================================================================*/
+static BOOL program_main_loop (ProgramContext *context, 
+       Panel **panels, int npanels, Region **composite, int cx, int cy, 
+       Output **outputs, int noutputs, Metrics *metrics)
+  {
+  LOG_IN
+  int usecs, idle_threshold, idle_usecs;
+  program_get_timing (context, &usecs, &idle_threshold, &idle_usecs);
+  int sleep_usecs = usecs;
+  BOOL paused = FALSE;
+  BOOL restart = FALSE;
+
+  int watch_fd = -1;
+  if (program_context_get_boolean (context, "watch-rc", FALSE))
+    watch_fd = program_context_watch_rc_files (context);
+
+  Control *control = NULL;
+  const char *control_path = program_context_get (context, "control");
+  if (control_path)
+    {
+    char *error = NULL;
+    control = control_create (control_path, &error);
+    if (control == NULL)
+      {
+      log_warning (error);
+      free (error);
+      }
+    }
+
+  Recorder *recorder = program_create_recorder (context);
+
+  BOOL direct = program_context_get_boolean (context, "direct", FALSE);
+  if (direct && (npanels > 1 || noutputs > 1 
+       || output_get_scale (outputs[0]) > 1 || recorder))
+    {
+    log_warning ("Direct drawing is only possible with one panel, "
+      "on one output, without magnification or recording");
+    direct = FALSE;
+    }
+
+  PerfCounters *perf = NULL;
+  if (program_context_get_boolean (context, "perf-counters", FALSE))
+    {
+    char *error = NULL;
+    perf = perfcounters_create (&error);
+    if (perf == NULL)
+      {
+      log_warning (error);
+      free (error);
+      }
+    }
+  int64_t perf_report_start = program_now_usec();
+  int perf_frames = 0;
+
+  BOOL stop = FALSE;
+  pthread_barrier_t barrier;
+  ProgramWorker *workers = NULL;
+  if (npanels > 1)
+    {
+    pthread_barrier_init (&barrier, NULL, npanels + 1);
+    workers = malloc (npanels * sizeof (ProgramWorker));
+    for (int i = 0; i < npanels; i++)
+      {
+      workers[i].panel = panels[i];
+      workers[i].barrier = &barrier;
+      workers[i].stop = &stop;
+      workers[i].index = i + 1;
+      workers[i].count = perf != NULL;
+      workers[i].perf = NULL;
+      pthread_create (&workers[i].thread, NULL, 
+        program_panel_worker, &workers[i]);
+      }
+    }
+
+  while (!program_quit && !restart)
+    {
+    if (!paused)
+      {
+      int64_t frame_start = program_now_usec();
+      TRACE_BEGIN (frame_trace);
+      if (direct)
+        {
+        perfcounters_begin (perf);
+        panel_draw_to_fb (panels[0], output_get_framebuffer (outputs[0]), 
+          output_get_x (outputs[0]), output_get_y (outputs[0]));
+        perfcounters_end (perf, PERF_PHASE_RENDER);
+        perfcounters_begin (perf);
+        panel_step (panels[0]);
+        perfcounters_end (perf, PERF_PHASE_SIMULATION);
+        }
+      else if (npanels == 1)
+        {
+        perfcounters_begin (perf);
+        panel_draw (panels[0]);
+        for (int i = 0; i < noutputs; i++)
+          output_submit (outputs[i], panel_get_region (panels[0]));
+        if (recorder) 
+          panel_record (panels[0], recorder);
+        perfcounters_end (perf, PERF_PHASE_RENDER);
+        perfcounters_begin (perf);
+        panel_step (panels[0]);
+        perfcounters_end (perf, PERF_PHASE_SIMULATION);
+        }
+      else
+        {
+        pthread_barrier_wait (&barrier);
+        pthread_barrier_wait (&barrier);
+        perfcounters_begin (perf);
+        TRACE_BEGIN (t);
+        for (int i = 0; i < npanels; i++)
+          region_paste (*composite, panel_get_region (panels[i]), 
+            panel_get_x (panels[i]) - cx, panel_get_y (panels[i]) - cy);
+        TRACE_END (t, "program", "composite");
+        for (int i = 0; i < noutputs; i++)
+          output_submit (outputs[i], *composite);
+        if (recorder)
+          *composite = recorder_submit (recorder, *composite);
+        perfcounters_end (perf, PERF_PHASE_RENDER);
+        for (int i = 0; perf && i < npanels; i++)
+          if (workers[i].perf) 
+            perfcounters_merge (perf, workers[i].perf);
+        }
+
+      int generations = 0, population = 0, changed = 0;
+      for (int i = 0; i < npanels; i++)
+        {
+        if (panel_get_reseeded (panels[i]))
+          metrics_add_reseed (metrics);
+        generations += panel_get_generations (panels[i]);
+        population += life_get_population (panel_get_life (panels[i]));
+        changed += life_get_changed (panel_get_life (panels[i]));
+        }
+      metrics_add_frame (metrics, generations, population, 
+        program_now_usec() - frame_start);
+      TRACE_END (frame_trace, "program", "frame");
+
+      if (perf)
+        {
+        perf_frames++;
+        if (program_now_usec() - perf_report_start 
+              >= PERF_REPORT_INTERVAL * 1000000LL)
+          {
+          perfcounters_report (perf, perf_frames);
+          perf_frames = 0;
+          perf_report_start = program_now_usec();
+          }
+        }
+
+      // If hardly anything is happening, wait a little longer each frame,
+      //   up to the idle interval; go back to the full rate as soon as
+      //   the pattern livens up, or is reseeded
+      if (changed < idle_threshold)
+        {
+        if (sleep_usecs < idle_usecs)
+          {
+          if (sleep_usecs == usecs)
+            log_debug ("Only %d cells changed -- slowing down", changed);
+          sleep_usecs *= 2;
+          if (sleep_usecs < IDLE_MIN_INTERVAL * 1000) 
+            sleep_usecs = IDLE_MIN_INTERVAL * 1000;
+          if (sleep_usecs > idle_usecs) 
+            sleep_usecs = idle_usecs;
+          }
+        }
+      else if (sleep_usecs != usecs)
+        {
+        log_debug ("%d cells changed -- back to full speed", changed);
+        sleep_usecs = usecs;
+        }
+      }
+
+    BOOL retime = FALSE;
+    char *command;
+    int client;
+    while (control && (command = control_get_command (control, &client)))
+      {
+      program_do_command (context, control, client, command, panels, 
+        npanels, output_get_framebuffer (outputs[0]), metrics, &paused, 
+        &retime);
+      free (command);
+      }
+    if (watch_fd >= 0 && program_context_rc_files_changed (context, 
+          watch_fd))
+      program_reload = TRUE;
+    if (program_reload)
+      {
+      program_reload = FALSE;
+      restart = program_reload_settings (context, panels, npanels, 
+        noutputs, output_get_framebuffer (outputs[0]));
+      retime = TRUE;
+      }
+    if (retime)
+      {
+      program_get_timing (context, &usecs, &idle_threshold, &idle_usecs);
+      sleep_usecs = usecs;
+      }
+    if (program_dump_trace)
+      {
+      program_dump_trace = FALSE;
+      program_write_trace (context);
+      }
+
+    if (!restart)
+      {
+      TRACE_BEGIN (t);
+      usleep (paused ? PAUSE_INTERVAL * 1000 : sleep_usecs); 
+      TRACE_END (t, "program", "sleep");
+      }
+    }
+
+  if (workers)
+    {
+    stop = TRUE;
+    pthread_barrier_wait (&barrier);
+    for (int i = 0; i < npanels; i++)
+      pthread_join (workers[i].thread, NULL);
+    pthread_barrier_destroy (&barrier);
+    free (workers);
+    }
+
+  for (int i = 0; i < noutputs; i++)
+    {
+    int dropped = output_get_dropped (outputs[i]);
+    if (dropped) 
+      log_info ("Output %d dropped %d frames", i + 1, dropped);
+    }
+
+  if (recorder)
+    {
+    log_info ("Recorded %d frames; dropped %d", 
+      recorder_get_written (recorder), recorder_get_dropped (recorder));
+    recorder_destroy (recorder);
+    }
+  if (perf && perf_frames > 0)
+    perfcounters_report (perf, perf_frames);
+  perfcounters_destroy (perf);
+  if (control) control_destroy (control);
+  if (watch_fd >= 0) close (watch_fd);
+  LOG_OUT
+  return restart;
+  }
+
+/*==========================================================================
+
+  program_run_once
+
+  Set up the panels -- just one, unless the "panels" setting says 
+  otherwise, in which case each has its own settings taken from
+  "panel.N.xxx" in the RC files -- and the outputs -- one for each
+  framebuffer in the comma-separated "fbdev" setting. Then run the 
+  main loop until told to quit, or until the settings are reloaded
+  and need everything to be set up again, in which case return TRUE.
+
+  With more than one panel, the panels are drawn into a single Region 
+  that covers them all, which is copied to the framebuffer in one go.
+  This region is initialized from the (first) framebuffer, so anything 
+  that is on the screen between the panels stays there. The positions
+  of the panels are checked against the first framebuffer.
+
+==========================================================================*/
+static BOOL program_run_once (ProgramContext *context, Metrics *metrics)
+  {
+  BOOL restart = FALSE;
+  log_set_level (program_context_get_integer (context, "log-level", 
+      LOG_WARNING));
+  const char *fbdev = "/dev/fb0";
+  const char *arg_fbdev = program_context_get (context, "fbdev");
+  if (arg_fbdev) fbdev = arg_fbdev;
+
+  FrameBuffer **fbs;
+  int nfbs = program_open_framebuffers (fbdev, &fbs);
+  if (nfbs > 0)
+    {
+    FrameBuffer *fb = fbs[0];
+    int npanels = program_context_get_integer (context, "panels", 1);
+    if (npanels < 1) npanels = 1;
+    ProgramContext **panel_contexts = malloc 
+      (npanels * sizeof (ProgramContext *));
+    BOOL ok = TRUE;
+    for (int i = 0; i < npanels; i++)
+      {
+      panel_contexts[i] = program_context_create_panel (context, i + 1);
+      if (ok && !program_check_context (panel_contexts[i], fb))
+        {
+        if (npanels > 1) log_error ("Error in settings for panel %d", i + 1);
+        ok = FALSE;
+        }
+      }
+
+    if (ok)
+      {
+      BOOL erase = program_context_get_boolean (context, "erase", FALSE);
+      srand (program_context_get_integer (context, "seed", time (NULL)));
+
+      Panel **panels = malloc (npanels * sizeof (Panel *));
+      for (int i = 0; i < npanels; i++)
+        {
+        panels[i] = program_create_panel (panel_contexts[i], fb);
+        const char *pattern = program_context_get (panel_contexts[i], 
+          "pattern");
+        char *error = NULL;
+        if (pattern && !panel_load (panels[i], pattern, &error))
+          {
+          log_error ("%s", error);
+          free (error);
+          }
+        }
+
+      if (erase)
+        {
+        for (int i = 0; i < nfbs; i++)
+          framebuffer_clear (fbs[i]);
+        }
+
+      // The composite region covers all the panels
+      int cx1 = INT_MAX, cy1 = INT_MAX, cx2 = 0, cy2 = 0;
+      for (int i = 0; i < npanels; i++)
+        {
+        const Region *region = panel_get_region (panels[i]);
+        int x = panel_get_x (panels[i]), y = panel_get_y (panels[i]);
+        if (x < cx1) cx1 = x;
+        if (y < cy1) cy1 = y;
+        if (x + region_get_width (region) > cx2) 
+          cx2 = x + region_get_width (region);
+        if (y + region_get_height (region) > cy2) 
+          cy2 = y + region_get_height (region);
+        }
+      Region *composite = NULL;
+      if (npanels > 1)
+        {
+        composite = region_create (cx2 - cx1, cy2 - cy1);
+        region_from_fb (composite, fb, cx1, cy1);
+        }
+
+      Output **outputs = program_create_outputs (context, fbs, nfbs, 
+        cx1, cy1, cx2 - cx1, cy2 - cy1);
+      if (outputs)
+        {
+        // Hide cursor
+        fputs("\e[?25l", stdout);
+        fflush (stdout);
+
+        restart = program_main_loop (context, panels, npanels, 
+          &composite, cx1, cy1, outputs, nfbs, metrics);
+
+        // The outputs own the framebuffers
+        for (int i = 0; i < nfbs; i++)
+          output_destroy (outputs[i]);
+        free (outputs);
+        nfbs = 0;
+
+        // Show the cursor
+        printf("\e[?25h"); 
+        fflush (stdout);
+        }
+
+      for (int i = 0; i < npanels; i++)
+        panel_destroy (panels[i]);
+      free (panels);
+      if (composite) region_destroy (composite);
+      }
+    else
+      {
+      // Do nothing -- error already reported
+      }
+
+    for (int i = 0; i < npanels; i++)
+      program_context_destroy (panel_contexts[i]);
+    free (panel_contexts);
+    for (int i = 0; i < nfbs; i++)
+      {
+      framebuffer_deinit (fbs[i]);
+      framebuffer_destroy (fbs[i]);
+      }
+    free (fbs);
+    }
+
+  return restart;
+  }
+
+/*==========================================================================
+
+  program_count_numbers
+
+  Count the "%d" conversions, which may have a width, like "%04d", in
+  a snapshot filename. "%%" is allowed, for a literal '%'. Returns -1 
+  if there is any other kind of conversion, which would not be safe to
+  pass to printf.
+
+==========================================================================*/
+static int program_count_numbers (const char *filename)
+  {
+  int ret = 0;
+  for (const char *s = filename; *s; s++)
+    {
+    if (*s != '%') continue;
+    s++;
+    if (*s == '%') continue;
+    while (*s >= '0' && *s <= '9') s++;
+    if (*s != 'd') return -1;
+    ret++;
+    }
+  return ret;
+  }
+
+/*==========================================================================
+
+  program_snapshot
+
+  Take snapshots instead of running the display: seed a grid, or load
+  a pattern into it, advance it the given number of generations as 
+  fast as possible, then draw it, just as it would be drawn on the
+  screen, and write it to an image file. No framebuffer is opened. 
+
+  To save starting the program over and over, several snapshots can be
+  taken in one run; the filename must then contain "%d", which is
+  replaced by the number of the snapshot, counting from 1. With a 
+  random seed, each snapshot starts again from a new seed -- seed, 
+  seed + 1, and so on, if the seed is given. With a pattern, each one
+  carries on from the last, so they show the pattern every so many
+  generations. Only one panel is used. Returns the program's exit 
+  value.
+
+==========================================================================*/
+static int program_snapshot (ProgramContext *context)
+  {
+  LOG_IN
+  log_set_level (program_context_get_integer (context, "log-level", 
+      LOG_WARNING));
+  const char *filename = program_context_get (context, "snapshot");
+  const char *pattern = program_context_get (context, "pattern");
+  int generations = program_context_get_integer (context, "generations",
+    DEF_SNAPSHOT_GENERATIONS);
+  int count = program_context_get_integer (context, "snapshot-count",
+    DEF_SNAPSHOT_COUNT);
+  int numbers = program_count_numbers (filename);
+  ImageFormat format = image_format_from_filename (filename);
+
+  BOOL ok = program_check_context (context, NULL);
+  if (ok && (generations < 0 || count < 1))
+    {
+    log_error ("Generations must not be negative, and the snapshot "
+      "count must be at least 1");
+    ok = FALSE;
+    }
+  if (ok && (numbers > 1 || numbers < 0 || (count > 1 && numbers == 0)))
+    {
+    log_error ("Snapshot filename must contain one %%d, and no other "
+      "conversions, to take more than one snapshot");
+    ok = FALSE;
+    }
+
+  if (ok)
+    {
+    unsigned int seed = program_context_get_integer (context, "seed", 
+      time (NULL));
+    srand (seed);
+    Panel *panel = program_create_panel (context, NULL);
+    Life *life = panel_get_life (panel);
+    for (int i = 0; i < count && ok; i++)
+      {
+      char *error = NULL;
+      if (pattern)
+        {
+        if (i == 0)
+          ok = panel_load (panel, pattern, &error);
+        }
+      else if (i > 0)
+        {
+        srand (seed + i);
+        panel_reseed (panel);
+        }
+
+      if (ok)
+        {
+        life_step_n (life, generations);
+        panel_draw (panel);
+        char *name;
+        if (numbers)
+          asprintf (&name, filename, i + 1);
+        else
+          name = strdup (filename);
+        ok = image_write (panel_get_region (panel), name, format, &error);
+        if (ok)
+          log_debug ("Wrote %s, population %d", name, 
+            life_get_population (life));
+        free (name);
+        }
+      if (!ok)
+        {
+        log_error ("%s", error);
+        free (error);
+        }
+      }
+    panel_destroy (panel);
+    }
+
+  LOG_OUT
+  return ok ? 0 : 1;
+  }
+
+/*==========================================================================
+
+  program_run
+
+  Run until told to quit, setting everything up again each time 
+  reloading the settings changes the layout. SIGHUP reloads the 
+  settings; SIGUSR1 writes the trace, if there is one; the other 
+  usual signals quit. With "trace", tracing starts here, before any
+  other threads, and the trace is written on the way out. The metrics
+  also last for the whole run, so that the counters carry on, and the
+  shared memory segment stays put, when everything is set up again;
+  turning on "metrics" in a reload publishes them then.
+
+==========================================================================*/
+int program_run (ProgramContext *context)
+  {
+  int ret = 0;
+  if (program_context_get (context, "trace"))
+    {
+    char *error = NULL;
+    if (!trace_start (&error))
+      {
+      log_warning (error);
+      free (error);
+      }
+    }
+
+  if (program_context_get (context, "snapshot"))
+    ret = program_snapshot (context);
+  else
+    {
+    signal (SIGQUIT, program_quit_signal);
+    signal (SIGTERM, program_quit_signal);
+    signal (SIGHUP, program_reload_signal);
+    signal (SIGINT, program_quit_signal);
+    signal (SIGUSR1, program_trace_signal);
+    // Writing to a command that has exited, when recording, should be 
+    //   an error, not fatal
+    signal (SIGPIPE, SIG_IGN);
+
+    Metrics *metrics = metrics_create();
+    BOOL restart;
+    do
+      {
+      if (program_context_get_boolean (context, "metrics", FALSE))
+        {
+        char *error = NULL;
+        if (!metrics_publish (metrics, &error))
+          {
+          log_warning (error);
+          free (error);
+          }
+        }
+      restart = program_run_once (context, metrics);
+      if (restart) log_info ("Starting again with the new settings");
+      } while (restart);
+    metrics_destroy (metrics);
+    }
+
+  program_write_trace (context);
+  return ret;
   }
 
@@ -22,6 +22,7 @@
 #include <stdarg.h>
 #include <errno.h>
 #include <getopt.h>
+#include <sys/inotify.h>
 #include "feature.h" 
 #include "defs.h" 
 #include "log.h" 
@@ -44,6 +45,11 @@ struct _ProgramContext
   //   may be set to 0 by the user. Printing functions will take -1
   //   to mean 'use console width', and 0 to mean 'do not format'. 
   int width;
+  // As given to program_context_read_rc_files, and the whole command
+  //   line, so that program_context_reread can read them again
+  char *rc_filename;
+  int saved_argc;
+  char **saved_argv;
   }; 
 
 
@@ -59,11 +65,43 @@ ProgramContext *program_context_create (void)
   props_put_integer (props, "log-level", LOG_WARNING);
   self->nonswitch_argc = 0;
   self->width = -1; // Might be overridden 
+  self->rc_filename = NULL;
+  self->saved_argc = 0;
+  self->saved_argv = NULL;
   LOG_OUT
   return self;
   }
 
 
+/*==========================================================================
+  program_context_create_panel
+
+  Create a new context for panel number 'panel' (counting from 1). It 
+  has all the settings of this one, overridden by any settings of the 
+  form "panel.N.name=value" -- these can only come from the RC files.
+  The caller must destroy the result.
+==========================================================================*/
+ProgramContext *program_context_create_panel (const ProgramContext *self,
+       int panel)
+  {
+  LOG_IN
+  ProgramContext *ret = malloc (sizeof (ProgramContext));
+  memcpy (ret, self, sizeof (ProgramContext));
+  ret->props = props_create();
+  ret->nonswitch_argc = 0;
+  ret->nonswitch_argv = NULL;
+  ret->rc_filename = NULL;
+  ret->saved_argc = 0;
+  ret->saved_argv = NULL;
+  props_put_all_prefixed (ret->props, self->props, "");
+  char prefix[32];
+  snprintf (prefix, sizeof (prefix), "panel.%d.", panel);
+  props_put_all_prefixed (ret->props, self->props, prefix);
+  LOG_OUT
+  return ret;
+  }
+
+
 /*==========================================================================
   program_context_parse_command_line
   This needs to be called after program_context_read_rc_files, in order
@@ -89,6 +127,16 @@ BOOL program_context_parse_command_line (ProgramContext *self,
   {
   LOG_IN
 
+  // getopt_long reorders argv, so save it first
+  if (self->saved_argv == NULL)
+    {
+    self->saved_argc = argc;
+    self->saved_argv = malloc ((argc + 1) * sizeof (char *));
+    for (int i = 0; i < argc; i++)
+      self->saved_argv[i] = strdup (argv[i]);
+    self->saved_argv[argc] = NULL;
+    }
+
   BOOL ret = TRUE;
   static struct option long_options[] =
     {
@@ -109,6 +157,26 @@ BOOL program_context_parse_command_line (ProgramContext *self,
       {"max-cycles", required_argument, NULL, 'm'},
       {"b-rule", required_argument, NULL, 0},
       {"s-rule", required_argument, NULL, 0},
+      {"rule", required_argument, NULL, 'r'},
+      {"metrics", no_argument, NULL, 0},
+      {"perf-counters", no_argument, NULL, 0},
+      {"trace", required_argument, NULL, 0},
+      {"topology", required_argument, NULL, 0},
+      {"follow", no_argument, NULL, 0},
+      {"scale", required_argument, NULL, 0},
+      {"direct", no_argument, NULL, 0},
+      {"idle-threshold", required_argument, NULL, 0},
+      {"idle-interval", required_argument, NULL, 0},
+      {"control", required_argument, NULL, 0},
+      {"watch-rc", no_argument, NULL, 0},
+      {"record", required_argument, NULL, 0},
+      {"record-format", required_argument, NULL, 0},
+      {"snapshot", required_argument, NULL, 0},
+      {"snapshot-count", required_argument, NULL, 0},
+      {"generations", required_argument, NULL, 0},
+      {"seed", required_argument, NULL, 0},
+      {"pattern", required_argument, NULL, 0},
+      {"generations-per-frame", required_argument, NULL, 'g'},
       {0, 0, 0, 0}
     };
 
@@ -116,7 +184,7 @@ BOOL program_context_parse_command_line (ProgramContext *self,
    while (ret)
      {
      int option_index = 0;
-     opt = getopt_long (argc, argv, "vl:w:h:x:y:f:t:c:p:m:i:s:b:e",
+     opt = getopt_long (argc, argv, "vl:w:h:x:y:f:t:c:p:m:i:s:b:er:g:",
      long_options, &option_index);
 
      if (opt == -1) break;
@@ -161,6 +229,51 @@ BOOL program_context_parse_command_line (ProgramContext *self,
            program_context_put (self, "b-rule", optarg); 
          else if (strcmp (long_options[option_index].name, "s-rule") == 0)
            program_context_put (self, "s-rule", optarg); 
+         else if (strcmp (long_options[option_index].name, "metrics") == 0)
+           program_context_put_boolean (self, "metrics", TRUE); 
+         else if (strcmp (long_options[option_index].name, 
+               "perf-counters") == 0)
+           program_context_put_boolean (self, "perf-counters", TRUE); 
+         else if (strcmp (long_options[option_index].name, "trace") == 0)
+           program_context_put (self, "trace", optarg); 
+         else if (strcmp (long_options[option_index].name, "topology") == 0)
+           program_context_put (self, "topology", optarg); 
+         else if (strcmp (long_options[option_index].name, "follow") == 0)
+           program_context_put_boolean (self, "follow", TRUE); 
+         else if (strcmp (long_options[option_index].name, "scale") == 0)
+           program_context_put_integer (self, "scale", atoi (optarg)); 
+         else if (strcmp (long_options[option_index].name, "direct") == 0)
+           program_context_put_boolean (self, "direct", TRUE); 
+         else if (strcmp (long_options[option_index].name, 
+               "idle-threshold") == 0)
+           program_context_put_integer (self, "idle-threshold", 
+             atoi (optarg)); 
+         else if (strcmp (long_options[option_index].name, 
+               "idle-interval") == 0)
+           program_context_put_integer (self, "idle-interval", 
+             atoi (optarg)); 
+         else if (strcmp (long_options[option_index].name, "control") == 0)
+           program_context_put (self, "control", optarg); 
+         else if (strcmp (long_options[option_index].name, "watch-rc") == 0)
+           program_context_put_boolean (self, "watch-rc", TRUE); 
+         else if (strcmp (long_options[option_index].name, "record") == 0)
+           program_context_put (self, "record", optarg); 
+         else if (strcmp (long_options[option_index].name, 
+               "record-format") == 0)
+           program_context_put (self, "record-format", optarg); 
+         else if (strcmp (long_options[option_index].name, "snapshot") == 0)
+           program_context_put (self, "snapshot", optarg); 
+         else if (strcmp (long_options[option_index].name, 
+               "snapshot-count") == 0)
+           program_context_put_integer (self, "snapshot-count", 
+             atoi (optarg)); 
+         else if (strcmp (long_options[option_index].name, 
+               "generations") == 0)
+           program_context_put_integer (self, "generations", atoi (optarg)); 
+         else if (strcmp (long_options[option_index].name, "seed") == 0)
+           program_context_put_integer (self, "seed", atoi (optarg)); 
+         else if (strcmp (long_options[option_index].name, "pattern") == 0)
+           program_context_put (self, "pattern", optarg); 
          else
            exit (-1);
          break;
@@ -190,12 +303,16 @@ BOOL program_context_parse_command_line (ProgramContext *self,
            atoi (optarg)); break;
        case 'i': program_context_put_integer (self, "interval", 
            atoi (optarg)); break;
+       case 'g': program_context_put_integer (self, "generations-per-frame", 
+           atoi (optarg)); break;
        case 'f': program_context_put (self, "fbdev", 
            optarg); break;
        case 'c': program_context_put (self, "colour", 
            optarg); break;
        case 'b': program_context_put (self, "border-colour", 
            optarg); break;
+       case 'r': program_context_put (self, "rule", 
+           optarg); break;
        default:
          ret = FALSE; 
        }
@@ -246,6 +363,10 @@ void program_context_destroy (ProgramContext *self)
     for (int i = 0; i < self->nonswitch_argc; i++)
       free (self->nonswitch_argv[i]);
     free (self->nonswitch_argv);
+    for (int i = 0; i < self->saved_argc; i++)
+      free (self->saved_argv[i]);
+    free (self->saved_argv);
+    free (self->rc_filename);
     free (self);
     }
   LOG_OUT
@@ -296,6 +417,8 @@ void program_context_read_rc_files (ProgramContext *self,
        const char *rc_filename)
   {
   LOG_IN
+  if (self->rc_filename == NULL) 
+    self->rc_filename = strdup (rc_filename);
   // Note that you can call props_read_from_file on multiple files, and
   //   values from the later reads will over-write the earlier ones. So
   //   you could read from /etc and from a home directory, for example
@@ -314,6 +437,138 @@ void program_context_put (ProgramContext *self, const char *name,
   props_put (self->props, name, value);
   }
 
+/*==========================================================================
+
+  program_context_reread
+
+  Create a new context from the same RC files and command line as this
+  one, so as to pick up any changes to the RC files. Returns NULL if
+  the command line can't be parsed, which should not happen, as it
+  has been parsed once already. The caller must destroy the result.
+
+==========================================================================*/
+ProgramContext *program_context_reread (const ProgramContext *self)
+  {
+  LOG_IN
+  ProgramContext *ret = program_context_create();
+  ret->stdout_is_tty = self->stdout_is_tty;
+  ret->console_width = self->console_width;
+  ret->width = self->width;
+  if (self->rc_filename)
+    program_context_read_rc_files (ret, self->rc_filename);
+  optind = 0; // Make getopt start again
+  if (self->saved_argv && !program_context_parse_command_line 
+       (ret, self->saved_argc, self->saved_argv))
+    {
+    program_context_destroy (ret);
+    ret = NULL;
+    }
+  LOG_OUT
+  return ret;
+  }
+
+
+/*==========================================================================
+
+  program_context_replace
+
+  Replace the settings in this context with those in 'other', which 
+  is then destroyed
+
+==========================================================================*/
+void program_context_replace (ProgramContext *self, ProgramContext *other)
+  {
+  LOG_IN
+  Props *temp = self->props;
+  self->props = other->props;
+  other->props = temp;
+  program_context_destroy (other);
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+
+  program_context_watch_rc_files
+
+  Start watching for changes to the RC files, using inotify. Editors 
+  often write a new file and rename it over the old one, so it's the
+  directories that are watched. Returns a non-blocking file descriptor
+  for program_context_rc_files_changed, which the caller must close, or
+  -1 if inotify can't be used.
+
+==========================================================================*/
+int program_context_watch_rc_files (const ProgramContext *self)
+  {
+  LOG_IN
+  int fd = -1;
+  if (self->rc_filename)
+    fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+  if (fd >= 0)
+    {
+    uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO;
+#ifdef FEATURE_SYSTEM_RC
+    if (inotify_add_watch (fd, "/etc", mask) < 0)
+      log_warning ("Can't watch /etc: %s", strerror (errno));
+#endif
+#ifdef FEATURE_USER_RC
+    Path *path = path_create_home();
+    char *home = (char *)path_to_utf8 (path);
+    if (inotify_add_watch (fd, home, mask) < 0)
+      log_warning ("Can't watch %s: %s", home, strerror (errno));
+    free (home);
+    path_destroy (path);
+#endif
+    }
+  LOG_OUT
+  return fd;
+  }
+
+
+/*==========================================================================
+
+  program_context_rc_files_changed
+
+  Returns TRUE if either RC file has been written since the last call,
+  according to the inotify file descriptor from 
+  program_context_watch_rc_files. Never waits.
+
+==========================================================================*/
+BOOL program_context_rc_files_changed (const ProgramContext *self, int fd)
+  {
+  BOOL ret = FALSE;
+  char buff [4096] 
+    __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+  int n;
+  while ((n = read (fd, buff, sizeof (buff))) > 0)
+    {
+    char *p = buff;
+    while (p < buff + n)
+      {
+      const struct inotify_event *event = (const struct inotify_event *)p;
+      p += sizeof (struct inotify_event) + event->len;
+      if (event->len == 0) continue;
+      const char *name = event->name;
+      if (name[0] == '.') name++;
+      if (strcmp (name, self->rc_filename) == 0)
+        {
+        log_debug ("RC file %s changed", event->name);
+        ret = TRUE;
+        }
+      }
+    }
+  return ret;
+  }
+
+
+/*==========================================================================
+  program_context_delete
+==========================================================================*/
+void program_context_delete (ProgramContext *self, const char *name)
+  {
+  props_delete (self->props, name);
+  }
+
 /*==========================================================================
   program_context_get
 ==========================================================================*/
@@ -18,6 +18,8 @@ BEGIN_DECLS
 
 void program_context_destroy (ProgramContext *self);
 ProgramContext *program_context_create (void);
+ProgramContext *program_context_create_panel (const ProgramContext *self,
+       int panel);
 void program_context_read_rc_files (ProgramContext *self, 
   const char *rc_filename);
 void program_context_read_system_rc_file (ProgramContext *self, 
@@ -27,6 +29,11 @@ void program_context_read_user_rc_file (ProgramContext *self,
 void program_context_put (ProgramContext *self, const char *name, 
     const char *value);
 const char *program_context_get (const ProgramContext *self, const char *key);
+void program_context_delete (ProgramContext *self, const char *name);
+ProgramContext *program_context_reread (const ProgramContext *self);
+void program_context_replace (ProgramContext *self, ProgramContext *other);
+int program_context_watch_rc_files (const ProgramContext *self);
+BOOL program_context_rc_files_changed (const ProgramContext *self, int fd);
 void program_context_put_boolean (ProgramContext *self, 
     const char *key, BOOL value);
 void program_context_put_integer (ProgramContext *self, 
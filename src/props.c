@@ -134,7 +134,7 @@ void props_delete (Props *self, const char *name)
   for (int i = 0; i < l && !found; i++)
     {
     const NameValuePair *nvp = list_get (self->list, i);
-    if (nvp)
+    if (strcmp (nvp_get_name (nvp), name) == 0)
       {
       log_debug ("props_delete, found NVP, deleting", name);
       list_remove_object (self->list, nvp);
@@ -177,7 +177,8 @@ Props *props_create (void)
 
   Props *self = malloc (sizeof (Props));
 
-  List *list = list_create ((ListItemFreeFn)nvp_destroy);
+  // Props are only ever accessed from the main thread
+  List *list = list_create_unlocked ((ListItemFreeFn)nvp_destroy);
   self->list = list;
 
   return self;
@@ -248,6 +249,31 @@ void props_put_int64 (Props *self, const char *name, int64_t value)
   }
 
 
+/*==========================================================================
+  props_put_all_prefixed
+
+  Copy into this Props every entry of 'other' whose name starts with
+  prefix, with the prefix removed from the name. So with prefix 
+  "panel.2.", an entry "panel.2.width=40" becomes "width=40"
+*==========================================================================*/
+void props_put_all_prefixed (Props *self, const Props *other, 
+       const char *prefix)
+  {
+  LOG_IN
+  int prefix_len = strlen (prefix);
+  int l = list_length (other->list);
+  for (int i = 0; i < l; i++)
+    {
+    const NameValuePair *nvp = list_get (other->list, i); 
+    const char *name = nvp_get_name (nvp);
+    if (strncmp (name, prefix, prefix_len) == 0)
+      props_put (self, name + prefix_len, 
+        string_cstr (nvp_get_value (nvp)));
+    }
+  LOG_OUT
+  }
+
+
 /*==========================================================================
   props_read_from_path
 *==========================================================================*/
@@ -31,6 +31,8 @@ int64_t     props_get_int64 (const Props *self, const char *key,
               int64_t deflt);
 void        props_dump (const Props *self);
 BOOL        props_read_from_path (Props *self, const Path *path);
+void        props_put_all_prefixed (Props *self, const Props *other, 
+              const char *prefix);
 
 END_DECLS
 
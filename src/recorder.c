@@ -0,0 +1,338 @@
+/*============================================================================
+
+  fblife
+  recorder.c
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  A Recorder writes frames to a file or, if the path starts with '|',
+  to the standard input of a command -- ffmpeg, for example. The frames
+  are written either as raw 24-bit RGB, with nothing in between, or as
+  YUV4MPEG2 ("Y4M"), which has a header giving the frame size and rate.
+
+  Writing is done by a thread of its own, so that a slow disk or
+  encoder does not hold up the display. recorder_submit() does not copy
+  the frame: it puts the caller's Region on a queue, and gives back
+  another, spare, Region of the same size for the caller to draw the
+  next frame in. Regions that have been written go back on the spare
+  list. The spares are made, as needed, by cloning the frames that are
+  submitted, so anything that the caller does not redraw each frame
+  (the background around a set of panels, for example) stays the same.
+  If the queue is full, the frame is not queued, but counted as
+  dropped, and the caller just gets its own Region back.
+
+  If writing fails -- because the command has exited, perhaps -- the
+  error is reported once, and all further frames are dropped.
+
+============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "defs.h"
+#include "log.h"
+#include "region.h"
+#include "recorder.h"
+#include "trace.h"
+
+struct _Recorder
+  {
+  FILE *f;
+  BOOL is_pipe;
+  RecorderFormat format;
+  int fps_num;
+  int fps_den;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  Region *queue [RECORDER_QUEUE_LENGTH]; // Circular
+  int head;
+  int queued;
+  Region *spare [RECORDER_QUEUE_LENGTH + 2];
+  int nspare;
+  BOOL stop;
+  BOOL failed;
+  int written;
+  int dropped;
+  BYTE *buff; // Converted frame, w * h * 3 bytes
+  int w;
+  int h;
+  };
+
+
+/*==========================================================================
+
+  recorder_convert_rgb
+
+  Convert from the Region's BGR to RGB
+
+*==========================================================================*/
+static void recorder_convert_rgb (const BYTE *in, BYTE *out, int pixels)
+  {
+  for (int i = 0; i < pixels; i++, in += 3, out += 3)
+    {
+    out[0] = in[2];
+    out[1] = in[1];
+    out[2] = in[0];
+    }
+  }
+
+
+/*==========================================================================
+
+  recorder_convert_y4m
+
+  Convert from the Region's BGR to planar YUV 4:4:4, using the
+  ITU-R BT.601 coefficients and video ("studio swing") range, which is
+  what Y4M readers expect
+
+*==========================================================================*/
+static void recorder_convert_y4m (const BYTE *in, BYTE *out, int pixels)
+  {
+  BYTE *y = out, *u = out + pixels, *v = out + 2 * pixels;
+  for (int i = 0; i < pixels; i++, in += 3)
+    {
+    int b = in[0], g = in[1], r = in[2];
+    y[i] = 16 + ((66 * r + 129 * g + 25 * b + 128) >> 8);
+    u[i] = 128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8);
+    v[i] = 128 + ((112 * r - 94 * g - 18 * b + 128) >> 8);
+    }
+  }
+
+
+/*==========================================================================
+
+  recorder_write
+
+  Write one frame, and the Y4M header before the first. Returns FALSE
+  if writing fails
+
+*==========================================================================*/
+static BOOL recorder_write (Recorder *self, const Region *frame)
+  {
+  int w = region_get_width (frame), h = region_get_height (frame);
+  int pixels = w * h;
+  if (self->buff == NULL)
+    {
+    self->w = w;
+    self->h = h;
+    self->buff = malloc (pixels * 3);
+    log_info ("Recording %d x %d frames, in %s format", w, h,
+      self->format == RECORDER_FORMAT_Y4M ? "Y4M" : "RGB24");
+    if (self->format == RECORDER_FORMAT_Y4M)
+      fprintf (self->f, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C444\n",
+        w, h, self->fps_num, self->fps_den);
+    }
+
+  if (self->format == RECORDER_FORMAT_Y4M)
+    {
+    fputs ("FRAME\n", self->f);
+    recorder_convert_y4m (region_get_data (frame), self->buff, pixels);
+    }
+  else
+    recorder_convert_rgb (region_get_data (frame), self->buff, pixels);
+
+  return fwrite (self->buff, 3, pixels, self->f) == (size_t)pixels;
+  }
+
+
+/*==========================================================================
+
+  recorder_thread
+
+  Write frames until told to stop and the queue is empty. After a
+  failure, queued frames are just discarded
+
+*==========================================================================*/
+static void *recorder_thread (void *arg)
+  {
+  Recorder *self = arg;
+  TRACE_THREAD_NAME ("recorder");
+  pthread_mutex_lock (&self->mutex);
+  for (;;)
+    {
+    while (self->queued == 0 && !self->stop)
+      pthread_cond_wait (&self->cond, &self->mutex);
+    if (self->queued == 0) break;
+    Region *frame = self->queue [self->head];
+    self->head = (self->head + 1) % RECORDER_QUEUE_LENGTH;
+    self->queued--;
+    BOOL failed = self->failed;
+    pthread_mutex_unlock (&self->mutex);
+
+    BOOL ok = FALSE;
+    if (!failed)
+      {
+      TRACE_BEGIN (t);
+      ok = recorder_write (self, frame);
+      TRACE_END (t, "recorder", "write");
+      if (!ok)
+        log_error ("Recording stopped: %s", strerror (errno));
+      }
+
+    pthread_mutex_lock (&self->mutex);
+    self->spare [self->nspare++] = frame;
+    if (ok)
+      self->written++;
+    else 
+      {
+      self->dropped++;
+      self->failed = TRUE;
+      }
+    }
+  pthread_mutex_unlock (&self->mutex);
+  return NULL;
+  }
+
+
+/*==========================================================================
+
+  recorder_create
+
+  Open the file, or start the command if the path starts with '|'. The
+  frame rate is fps_num / fps_den frames per second; it only matters
+  for Y4M. Returns NULL, and sets error, if the file can't be opened.
+
+*==========================================================================*/
+Recorder *recorder_create (const char *path, RecorderFormat format,
+       int fps_num, int fps_den, char **error)
+  {
+  LOG_IN
+  BOOL is_pipe = (path[0] == '|');
+  FILE *f = is_pipe ? popen (path + 1, "w") : fopen (path, "w");
+  if (f == NULL)
+    {
+    if (error)
+      asprintf (error, "Can't record to %s: %s", path, strerror (errno));
+    LOG_OUT
+    return NULL;
+    }
+
+  Recorder *self = malloc (sizeof (Recorder));
+  memset (self, 0, sizeof (Recorder));
+  self->f = f;
+  self->is_pipe = is_pipe;
+  self->format = format;
+  self->fps_num = fps_num;
+  self->fps_den = fps_den;
+  pthread_mutex_init (&self->mutex, NULL);
+  pthread_cond_init (&self->cond, NULL);
+  pthread_create (&self->thread, NULL, recorder_thread, self);
+  LOG_OUT
+  return self;
+  }
+
+
+/*==========================================================================
+
+  recorder_destroy
+
+  Write any frames that are still queued, then close the file or wait
+  for the command to finish
+
+*==========================================================================*/
+void recorder_destroy (Recorder *self)
+  {
+  LOG_IN
+  if (self)
+    {
+    pthread_mutex_lock (&self->mutex);
+    self->stop = TRUE;
+    pthread_cond_signal (&self->cond);
+    pthread_mutex_unlock (&self->mutex);
+    pthread_join (self->thread, NULL);
+    pthread_cond_destroy (&self->cond);
+    pthread_mutex_destroy (&self->mutex);
+    for (int i = 0; i < self->nspare; i++)
+      region_destroy (self->spare[i]);
+    if (self->is_pipe)
+      pclose (self->f);
+    else
+      fclose (self->f);
+    free (self->buff);
+    free (self);
+    }
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+
+  recorder_submit
+
+  Queue a frame to be written, and return a Region to draw the next
+  one in -- see the notes at the top of this file. The recorder owns
+  the frame that is passed in, and the caller owns the one returned,
+  which might be the same one, if the frame was dropped. Every frame
+  must be the same size.
+
+*==========================================================================*/
+Region *recorder_submit (Recorder *self, Region *frame)
+  {
+  LOG_IN
+  Region *ret = frame;
+  pthread_mutex_lock (&self->mutex);
+  if (self->failed || self->queued == RECORDER_QUEUE_LENGTH)
+    self->dropped++;
+  else
+    {
+    int tail = (self->head + self->queued) % RECORDER_QUEUE_LENGTH;
+    self->queue [tail] = frame;
+    self->queued++;
+    if (self->nspare > 0)
+      ret = self->spare [--self->nspare];
+    else
+      ret = region_clone (frame);
+    pthread_cond_signal (&self->cond);
+    }
+  pthread_mutex_unlock (&self->mutex);
+  LOG_OUT
+  return ret;
+  }
+
+
+/*==========================================================================
+  recorder_get_written
+*==========================================================================*/
+int recorder_get_written (Recorder *self)
+  {
+  pthread_mutex_lock (&self->mutex);
+  int ret = self->written;
+  pthread_mutex_unlock (&self->mutex);
+  return ret;
+  }
+
+
+/*==========================================================================
+  recorder_get_dropped
+
+  The number of frames that were not recorded, because the writer
+  could not keep up, or had failed
+*==========================================================================*/
+int recorder_get_dropped (Recorder *self)
+  {
+  pthread_mutex_lock (&self->mutex);
+  int ret = self->dropped;
+  pthread_mutex_unlock (&self->mutex);
+  return ret;
+  }
+
+
+/*==========================================================================
+  recorder_parse_format
+
+  Parse "rgb" or "y4m". Returns FALSE if the name is not one of these
+*==========================================================================*/
+BOOL recorder_parse_format (const char *name, RecorderFormat *format)
+  {
+  if (strcasecmp (name, "rgb") == 0)
+    *format = RECORDER_FORMAT_RGB;
+  else if (strcasecmp (name, "y4m") == 0)
+    *format = RECORDER_FORMAT_Y4M;
+  else
+    return FALSE;
+  return TRUE;
+  }
+
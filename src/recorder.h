@@ -0,0 +1,39 @@
+/*============================================================================
+
+  fblife
+  recorder.h
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+============================================================================*/
+
+#pragma once
+
+#include "defs.h"
+#include "region.h"
+
+// The most frames that can be waiting to be written; any more are
+//   dropped
+#define RECORDER_QUEUE_LENGTH 8
+
+typedef enum
+  {
+  RECORDER_FORMAT_RGB, // Raw 24-bit RGB, frame after frame
+  RECORDER_FORMAT_Y4M  // YUV4MPEG2, 4:4:4
+  } RecorderFormat;
+
+struct _Recorder;
+typedef struct _Recorder Recorder;
+
+BEGIN_DECLS
+
+Recorder   *recorder_create (const char *path, RecorderFormat format,
+              int fps_num, int fps_den, char **error);
+void        recorder_destroy (Recorder *self);
+Region     *recorder_submit (Recorder *self, Region *frame);
+int         recorder_get_written (Recorder *self);
+int         recorder_get_dropped (Recorder *self);
+BOOL        recorder_parse_format (const char *name,
+              RecorderFormat *format);
+
+END_DECLS
+
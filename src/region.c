@@ -168,26 +168,34 @@ void region_destroy (Region *self)
 
 
 /*==========================================================================
-  region_to_fb
+
+  region_to_fb_scaled
+
+  Copy the region to the framebuffer with its top-left corner at x1,y1,
+  magnified by an integer factor: each pixel becomes a scale x scale 
+  square. 
+
+  If the FB is linear, with 32-bit pixels, we do it here, directly on
+  the FB's mapped data, because this is much faster: each row of the 
+  region is expanded into one row of the framebuffer, which is then 
+  just duplicated with memcpy() for the remaining scale - 1 rows. 
+  Each pixel is still converted by framebuffer_map_rgb(), so that the
+  colour channels go wherever the FB says they are. 
+  Otherwise, leave the FB to do it, rather than duplicating all the
+  fiddly logic in this class  
+
 *==========================================================================*/
-void region_to_fb (const Region *self, FrameBuffer *fb, int x1, int y1)
+void region_to_fb_scaled (const Region *self, FrameBuffer *fb, 
+       int x1, int y1, int scale)
   {
   LOG_IN
   int w_in = self->w;
   int h_in = self->h;
-
-  // We can do the copy to FB either in this method, or we can
-  //   just let the framebuffer do the math. If the FB is linear
-  //   we do it here, directly on the FB's mapped data, because
-  //   this is much faster. But if the FB is non-linear, leave
-  //   the FB to do it, rather than duplicating all the fiddly 
-  //   logic in this class  
-
-  if (!framebuffer_is_linear (fb))
+  if (!framebuffer_is_linear (fb) 
+      || framebuffer_get_bytes_per_pixel (fb) != 4)
     {
     for (int y = 0; y < h_in; y++)
       {
-      int xp = x1;
       int linestart24 = y * w_in;
       for (int x = 0; x < w_in; x++)
 	{
@@ -195,11 +203,10 @@ void region_to_fb (const Region *self, FrameBuffer *fb, int x1, int y1)
 	BYTE b = self->data [index24++];
 	BYTE g = self->data [index24++];
 	BYTE r = self->data [index24];
-
-	framebuffer_set_pixel (fb, x + x1, y + y1, 
-	  r, g, b);
-
-	xp++;
+        for (int dy = 0; dy < scale; dy++)
+          for (int dx = 0; dx < scale; dx++)
+	    framebuffer_set_pixel (fb, x * scale + dx + x1, 
+              y * scale + dy + y1, r, g, b);
 	}
       }
     }
@@ -207,23 +214,73 @@ void region_to_fb (const Region *self, FrameBuffer *fb, int x1, int y1)
     {
     BYTE *data = framebuffer_get_data (fb);
     int w_out = framebuffer_get_width (fb);
+    int row_bytes = w_in * scale * 4;
     for (int y = 0; y < h_in; y++)
       {
-      int xp = x1;
-      int linestart24 = y * w_in;
-      int linestart32 = (y + y1) * w_out;
+      const BYTE *in = self->data + y * w_in * BPP;
+      BYTE *out = data + ((y * scale + y1) * w_out + x1) * 4;
+      uint32_t *o = (uint32_t *)out;
       for (int x = 0; x < w_in; x++)
 	{
-	int index24 = (linestart24 + x) * BPP;
-	int index32 = (linestart32 + x + x1) * 4;
-	BYTE b = self->data [index24++];
-	BYTE g = self->data [index24++];
-	BYTE r = self->data [index24];
-	data [index32] = b;
-	data [index32+1] = g;
-	data [index32+2] = r;
-	xp++;
+	uint32_t pixel = framebuffer_map_rgb (fb, in[2], in[1], in[0]);
+        in += BPP;
+        for (int dx = 0; dx < scale; dx++)
+          *o++ = pixel;
 	}
+      for (int dy = 1; dy < scale; dy++)
+        memcpy (out + dy * w_out * 4, out, row_bytes);
+      }
+    }
+  LOG_OUT
+  }
+
+/*==========================================================================
+
+  region_to_fb
+
+*==========================================================================*/
+void region_to_fb (const Region *self, FrameBuffer *fb, int x1, int y1)
+  {
+  region_to_fb_scaled (self, fb, x1, y1, 1);
+  }
+
+
+
+/*==========================================================================
+
+  region_copy
+
+  Copy the contents of another region, which must be the same size
+
+*==========================================================================*/
+void region_copy (Region *self, const Region *other)
+  {
+  memcpy (self->data, other->data, self->w * self->h * BPP);
+  }
+
+
+/*==========================================================================
+
+  region_paste
+
+  Copy the whole of 'other' into this region, with its top-left corner 
+  at x1,y1. Anything that falls outside this region is clipped.
+
+*==========================================================================*/
+void region_paste (Region *self, const Region *other, int x1, int y1)
+  {
+  LOG_IN
+  int x_start = x1 < 0 ? -x1 : 0;
+  int x_end = x1 + other->w > self->w ? self->w - x1 : other->w;
+  if (x_end > x_start)
+    {
+    for (int y = 0; y < other->h; y++)
+      {
+      int yp = y + y1;
+      if (yp < 0 || yp >= self->h) continue;
+      memcpy (self->data + (yp * self->w + x1 + x_start) * BPP,
+        other->data + (y * other->w + x_start) * BPP, 
+        (x_end - x_start) * BPP);
       }
     }
   LOG_OUT
@@ -280,6 +337,19 @@ void region_darken (Region *self, int percent)
   LOG_OUT
   }
 
+/*==========================================================================
+
+  region_get_data
+
+  The pixels, row by row from the top, with no padding between rows. 
+  Each pixel is three bytes, in the order blue, green, red
+
+*==========================================================================*/
+const BYTE *region_get_data (const Region *self)
+  {
+  return self->data;
+  }
+
 /*==========================================================================
   region_get_width
 *==========================================================================*/
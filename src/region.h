@@ -25,11 +25,16 @@ void        region_draw_rect (Region *self, int x1, int y1,
                int x2, int y2, BYTE r, BYTE g, BYTE b);
 void        region_destroy (Region *self);
 void        region_to_fb (const Region *r, FrameBuffer *fb, int x, int y);
+void        region_to_fb_scaled (const Region *r, FrameBuffer *fb, 
+               int x, int y, int scale);
 void        region_from_fb (Region *self, const FrameBuffer *fb, int x, int y);
+void        region_copy (Region *self, const Region *other);
+void        region_paste (Region *self, const Region *other, int x, int y);
 void        region_darken (Region *self, int percent);
 Region     *region_clone (const Region *other);
 int         region_get_height (const Region *self);
 int         region_get_width (const Region *self);
+const BYTE *region_get_data (const Region *self);
 END_DECLS
 
 
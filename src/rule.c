@@ -0,0 +1,681 @@
+/*============================================================================
+
+  fblife
+  rule.c
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  Rule parses a rule string, and compiles it into a transition table
+  that the Life class can apply to each cell with a single lookup.
+
+  Cell states are numbered as follows:
+
+  0 -- dead
+  1 -- alive
+  2..states-1 -- dying. These only exist in "Generations" rules,
+    where a cell that fails to survive passes through a number of
+    decay states before it is finally dead. Dying cells do not count
+    as neighbours, and nothing can be born into a dying cell.
+
+  For ordinary two-state rules, states is 2, and a cell that fails to
+  survive becomes dead immediately.
+
+  The transition table has 'stride' entries for each state, indexed by
+  the number of live cells in the neighbourhood _including the cell
+  itself_. So the new state of a cell is 
+  table [state * stride + count]. Counting the centre cell along
+  with the others means that the Life class can count a whole block
+  of cells without having to treat the centre specially; the
+  table takes care of subtracting it where the rule requires.
+
+  The rule string formats accepted are:
+
+  B3/S23    -- birth/survival, in either order, any case
+  23/3      -- the traditional survival/birth format
+  B2/S/C3   -- Generations; C is the number of states
+  /2/3      -- Generations, in the survival/birth/states format
+  B2/S34H   -- the suffix H selects the hexagonal neighbourhood (six
+               neighbours), and V the von Neumann neighbourhood (the
+               four orthogonal neighbours). The suffix can go at the 
+               end of any of the parts, so it can be given with either 
+               --b-rule or --s-rule
+  B2-a/S12  -- isotropic non-totalistic, in Hensel notation. Each 
+               neighbour count can be followed by letters that select 
+               particular arrangements of the neighbours, or by '-' and
+               letters that exclude them. 
+
+  Isotropic non-totalistic rules cannot be expressed in terms of the 
+  number of neighbours, so for these the transition table is indexed
+  by the 3x3 pattern of live cells around (and including) the cell. 
+  Bit 0 is the north-west neighbour, bit 1 north, and so on along each
+  row to bit 8, the south-east; bit 4 is the cell itself. So the table
+  has a stride of 512, but it is still one lookup per cell.
+  R5,C0,M1,S34..58,B34..45,NM -- Larger than Life. R is the radius,
+               C the number of states (0 and 1 are taken as 2), M1 means
+               the centre cell is included in the count. NM (the
+               Moore, or box, neighbourhood) is the only one supported,
+               and can be omitted.
+
+============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <ctype.h>
+#include "defs.h"
+#include "log.h"
+#include "rule.h"
+
+// The largest number of states a Generations rule can have, since
+//   states are stored in a BYTE
+#define RULE_MAX_STATES 256
+
+// The largest number of neighbours in the Moore neighbourhood
+#define RULE_MAX_NEIGHBOURS 8
+
+struct _Rule
+  {
+  char *name;
+  RuleFamily family;
+  int states;
+  int radius;
+  // Totalistic rules -- flags indexed by the number of live neighbours
+  BOOL birth [RULE_MAX_NEIGHBOURS + 1];
+  BOOL survive [RULE_MAX_NEIGHBOURS + 1];
+  // Isotropic non-totalistic rules -- for each neighbour count, a bit
+  //   for each Hensel letter, and whether the letters are excluded
+  //   rather than included. If no letters are given for a count, 
+  //   all arrangements with that count match
+  BOOL hensel;
+  unsigned int birth_letters [RULE_MAX_NEIGHBOURS + 1];
+  unsigned int survive_letters [RULE_MAX_NEIGHBOURS + 1];
+  BOOL birth_negate [RULE_MAX_NEIGHBOURS + 1];
+  BOOL survive_negate [RULE_MAX_NEIGHBOURS + 1];
+  // Larger than Life rules -- ranges of counts
+  BOOL include_centre;
+  int birth_min, birth_max;
+  int survive_min, survive_max;
+  int stride;
+  BYTE *table;
+  };
+
+
+// The Hensel letters, in the order used by rule_hensel_patterns
+static const char *rule_hensel_letters = "ceaiknjqrytwz";
+
+// The number of letters that are valid with each neighbour count
+static const int rule_hensel_count [RULE_MAX_NEIGHBOURS + 1] = 
+  { 0, 2, 6, 10, 13, 10, 6, 2, 0 };
+
+// One example of the neighbourhood pattern for each letter, for 1-4
+//   neighbours. Any rotation or reflection of the example has the same
+//   letter. The letters for 5-8 neighbours denote the complements of
+//   the patterns with 3-0 neighbours
+static const int rule_hensel_patterns [5][13] =
+  {
+  { 0 },
+  { 1, 2 },
+  { 5, 10, 3, 40, 33, 68 },
+  { 69, 42, 11, 7, 98, 13, 14, 70, 41, 97 },
+  { 325, 170, 15, 45, 99, 71, 106, 102, 43, 101, 105, 78, 108 }
+  };
+
+// The eight neighbours of the centre in the 9-bit pattern
+#define RULE_NEIGHBOUR_MASK 0x1EF
+
+
+/*==========================================================================
+  rule_transform_pattern
+
+  Apply one of the eight rotations and reflections of the square to a
+  3x3 pattern
+*==========================================================================*/
+static int rule_transform_pattern (int pattern, int sym)
+  {
+  int ret = 0;
+  for (int i = 0; i < 9; i++)
+    {
+    if (pattern & (1 << i))
+      {
+      int x = i % 3 - 1, y = i / 3 - 1;
+      if (sym & 1) x = -x;
+      if (sym & 2) y = -y;
+      if (sym & 4) { int t = x; x = y; y = t; }
+      ret |= 1 << ((y + 1) * 3 + (x + 1));
+      }
+    }
+  return ret;
+  }
+
+
+/*==========================================================================
+  rule_hensel_letter
+
+  Work out the index into rule_hensel_letters of an arrangement of
+  n neighbours, or -1 if the count has no letters (0 and 8)
+*==========================================================================*/
+static int rule_hensel_letter (int pattern, int n)
+  {
+  pattern &= RULE_NEIGHBOUR_MASK;
+  if (n > 4)
+    {
+    pattern = ~pattern & RULE_NEIGHBOUR_MASK;
+    n = 8 - n;
+    }
+  for (int sym = 0; sym < 8; sym++)
+    {
+    int t = rule_transform_pattern (pattern, sym);
+    for (int i = 0; i < rule_hensel_count [n]; i++)
+      if (rule_hensel_patterns [n][i] == t) return i;
+    }
+  return -1;
+  }
+
+
+/*==========================================================================
+  rule_hensel_match
+
+  Whether a particular 3x3 pattern is selected by the flags and letters
+  of a birth or survival condition
+*==========================================================================*/
+static BOOL rule_hensel_match (const BOOL *flags, const unsigned int *letters,
+     const BOOL *negate, int pattern)
+  {
+  int n = __builtin_popcount (pattern & RULE_NEIGHBOUR_MASK);
+  if (!flags [n]) return FALSE;
+  if (letters [n] == 0) return TRUE;
+  int letter = rule_hensel_letter (pattern, n);
+  BOOL selected = (letter >= 0) && (letters [n] & (1 << letter));
+  return negate [n] ? !selected : selected;
+  }
+
+
+/*==========================================================================
+  rule_parse_suffix
+
+  Check for a neighbourhood suffix, H or V, and set the rule family
+  accordingly. Returns FALSE if c is not a suffix
+*==========================================================================*/
+static BOOL rule_parse_suffix (Rule *self, char c)
+  {
+  switch (toupper ((unsigned char)c))
+    {
+    case 'H': self->family = RULE_FAMILY_HEX; return TRUE;
+    case 'V': self->family = RULE_FAMILY_VON_NEUMANN; return TRUE;
+    }
+  return FALSE;
+  }
+
+
+/*==========================================================================
+  rule_parse_digits
+
+  Set the flags corresponding to each digit in the string s (up to the
+  first '/' or end of string), and the Hensel letters that follow each
+  digit, if any. Whether the digits are in range for the neighbourhood
+  is checked later, since the neighbourhood suffix may not have been
+  seen yet
+*==========================================================================*/
+static BOOL rule_parse_digits (Rule *self, const char *s, BOOL *flags, 
+     unsigned int *letters, BOOL *negate, char **error)
+  {
+  int digit = -1;
+  for (; *s && *s != '/'; s++)
+    {
+    const char *letter = strchr (rule_hensel_letters, 
+      tolower ((unsigned char)*s));
+    if (*s >= '0' && *s <= '0' + RULE_MAX_NEIGHBOURS)
+      {
+      digit = *s - '0';
+      flags [digit] = TRUE;
+      }
+    else if (*s == '-' && digit >= 0)
+      negate [digit] = TRUE;
+    else if (letter && *letter && digit >= 0)
+      {
+      int index = letter - rule_hensel_letters;
+      if (index >= rule_hensel_count [digit])
+        {
+        if (error)
+          asprintf (error, "'%c' is not valid after %d in rule", *s, digit);
+        return FALSE;
+        }
+      letters [digit] |= 1 << index;
+      self->hensel = TRUE;
+      }
+    else if (!rule_parse_suffix (self, *s))
+      {
+      if (error)
+        asprintf (error, "Invalid neighbour count '%c' in rule", *s);
+      return FALSE;
+      }
+    }
+  return TRUE;
+  }
+
+
+/*==========================================================================
+  rule_max_neighbours
+
+  The number of neighbours (not including the cell itself) in the
+  rule's neighbourhood
+*==========================================================================*/
+static int rule_max_neighbours (const Rule *self)
+  {
+  switch (self->family)
+    {
+    case RULE_FAMILY_HEX: return 6;
+    case RULE_FAMILY_VON_NEUMANN: return 4;
+    case RULE_FAMILY_LTL: 
+      return (2 * self->radius + 1) * (2 * self->radius + 1) - 1;
+    default: return RULE_MAX_NEIGHBOURS;
+    }
+  }
+
+
+/*==========================================================================
+  rule_check_digits
+
+  Check that no birth or survival count exceeds the size of the 
+  neighbourhood
+*==========================================================================*/
+static BOOL rule_check_digits (const Rule *self, char **error)
+  {
+  int max = rule_max_neighbours (self);
+  for (int n = max + 1; n <= RULE_MAX_NEIGHBOURS; n++)
+    {
+    if (self->birth [n] || self->survive [n])
+      {
+      if (error)
+        asprintf (error, "Neighbour count %d is too large for this "
+          "neighbourhood", n);
+      return FALSE;
+      }
+    }
+  return TRUE;
+  }
+
+
+/*==========================================================================
+  rule_parse_states
+*==========================================================================*/
+static BOOL rule_parse_states (Rule *self, const char *s, int *states, 
+     char **error)
+  {
+  char *end;
+  long n = strtol (s, &end, 10);
+  if (*end && rule_parse_suffix (self, *end)) end++;
+  if (end == s || (*end && *end != '/') || n < 2 || n > RULE_MAX_STATES)
+    {
+    if (error)
+      asprintf (error, "Number of states must be between 2 and %d",
+        RULE_MAX_STATES);
+    return FALSE;
+    }
+  *states = (int)n;
+  return TRUE;
+  }
+
+
+/*==========================================================================
+  rule_is_birth
+
+  Whether a dead cell with count live cells in its neighbourhood
+  becomes alive
+*==========================================================================*/
+static BOOL rule_is_birth (const Rule *self, int count)
+  {
+  if (self->family == RULE_FAMILY_LTL)
+    return count >= self->birth_min && count <= self->birth_max;
+  if (self->family == RULE_FAMILY_ISOTROPIC)
+    return rule_hensel_match (self->birth, self->birth_letters, 
+      self->birth_negate, count);
+  return count <= RULE_MAX_NEIGHBOURS && self->birth [count];
+  }
+
+
+/*==========================================================================
+  rule_is_survival
+
+  Whether a live cell with count live cells in its neighbourhood,
+  including itself, survives. For isotropic rules, count is the 3x3
+  pattern instead
+*==========================================================================*/
+static BOOL rule_is_survival (const Rule *self, int count)
+  {
+  if (self->family == RULE_FAMILY_ISOTROPIC)
+    return rule_hensel_match (self->survive, self->survive_letters, 
+      self->survive_negate, count);
+  if (self->family == RULE_FAMILY_LTL)
+    {
+    if (!self->include_centre) count--;
+    return count >= self->survive_min && count <= self->survive_max;
+    }
+  return count >= 1 && self->survive [count - 1];
+  }
+
+
+/*==========================================================================
+  rule_compile
+
+  Build the transition table from the birth and survival conditions
+*==========================================================================*/
+static void rule_compile (Rule *self)
+  {
+  int states = self->states;
+  if (self->family == RULE_FAMILY_ISOTROPIC)
+    self->stride = 512;
+  else
+    {
+    int side = 2 * self->radius + 1;
+    // Counts run from 0 to side * side inclusive 
+    self->stride = side * side + 1;
+    }
+  self->table = malloc (states * self->stride);
+  for (int n = 0; n < self->stride; n++)
+    {
+    BYTE *t = self->table + n;
+    // A dead cell does not count itself, so n is the neighbour count
+    t [0] = rule_is_birth (self, n) ? 1 : 0;
+    t [self->stride] = rule_is_survival (self, n) ? 1 : (states > 2 ? 2 : 0);
+    for (int state = 2; state < states; state++)
+      t [state * self->stride] = state + 1 < states ? state + 1 : 0;
+    }
+  }
+
+
+/*==========================================================================
+  rule_parse_range
+
+  Parse "min..max", or just "n"
+*==========================================================================*/
+static BOOL rule_parse_range (const char *s, int *min, int *max)
+  {
+  char *end;
+  *min = (int)strtol (s, &end, 10);
+  if (end == s) return FALSE;
+  if (strncmp (end, "..", 2) == 0)
+    {
+    s = end + 2;
+    *max = (int)strtol (s, &end, 10);
+    if (end == s) return FALSE;
+    }
+  else
+    *max = *min;
+  return (*end == 0 || *end == ',');
+  }
+
+
+/*==========================================================================
+  rule_parse_ltl
+
+  Parse the comma-separated fields of a Larger than Life rule
+*==========================================================================*/
+static BOOL rule_parse_ltl (Rule *self, const char *s, char **error)
+  {
+  BOOL ok = TRUE;
+  BOOL seen_b = FALSE, seen_s = FALSE;
+  self->family = RULE_FAMILY_LTL;
+  const char *p = s;
+  while (ok && *p)
+    {
+    char c = toupper ((unsigned char)*p);
+    p++;
+    char *end;
+    int n;
+    switch (c)
+      {
+      case 'R': 
+        n = (int)strtol (p, &end, 10);
+        if (end == p || n < 1 || n > RULE_MAX_RADIUS)
+          {
+          if (error) 
+            asprintf (error, "Radius must be between 1 and %d", 
+              RULE_MAX_RADIUS);
+          ok = FALSE;
+          }
+        self->radius = n;
+        break;
+      case 'C': 
+        n = (int)strtol (p, &end, 10);
+        if (n < 2) n = 2; 
+        if (end == p || n > RULE_MAX_STATES)
+          {
+          if (error) 
+            asprintf (error, "Number of states must be between 2 and %d",
+              RULE_MAX_STATES);
+          ok = FALSE;
+          }
+        self->states = n;
+        break;
+      case 'M': 
+        self->include_centre = (*p == '1');
+        break;
+      case 'S': 
+        ok = rule_parse_range (p, &self->survive_min, &self->survive_max);
+        if (!ok && error) asprintf (error, "Bad survival range in rule");
+        seen_s = TRUE;
+        break;
+      case 'B': 
+        ok = rule_parse_range (p, &self->birth_min, &self->birth_max);
+        if (!ok && error) asprintf (error, "Bad birth range in rule");
+        seen_b = TRUE;
+        break;
+      case 'N': 
+        if (toupper ((unsigned char)*p) != 'M')
+          {
+          if (error) 
+            asprintf (error, "Only the Moore (NM) neighbourhood is supported");
+          ok = FALSE;
+          }
+        break;
+      default:
+        if (error) asprintf (error, "Unknown rule field '%c'", c);
+        ok = FALSE;
+      }
+    p = strchr (p, ',');
+    p = p ? p + 1 : "";
+    }
+  if (ok && !(seen_b && seen_s))
+    {
+    if (error) asprintf (error, "Rule must have both B and S parts");
+    ok = FALSE;
+    }
+  return ok;
+  }
+
+
+/*==========================================================================
+  rule_parse
+
+  Returns NULL, and sets error, if the rule string cannot be parsed
+*==========================================================================*/
+Rule *rule_parse (const char *s, char **error)
+  {
+  LOG_IN
+  Rule *self = malloc (sizeof (Rule));
+  memset (self, 0, sizeof (Rule));
+  self->name = strdup (s);
+  self->states = 2;
+  self->radius = 1;
+  self->family = RULE_FAMILY_TOTALISTIC;
+
+  BOOL ok = TRUE;
+  if (toupper ((unsigned char)s[0]) == 'R' && isdigit ((unsigned char)s[1]))
+    ok = rule_parse_ltl (self, s, error);
+  else if (isalpha ((unsigned char)s[0]))
+    {
+    // Each field carries its own letter
+    BOOL seen_b = FALSE, seen_s = FALSE;
+    const char *p = s;
+    while (ok && *p)
+      {
+      char c = toupper ((unsigned char)*p);
+      p++;
+      if (c == 'B')
+        {
+        ok = rule_parse_digits (self, p, self->birth, self->birth_letters,
+          self->birth_negate, error);
+        seen_b = TRUE;
+        }
+      else if (c == 'S')
+        {
+        ok = rule_parse_digits (self, p, self->survive, 
+          self->survive_letters, self->survive_negate, error);
+        seen_s = TRUE;
+        }
+      else if (c == 'C' || c == 'G')
+        ok = rule_parse_states (self, p, &self->states, error);
+      else
+        {
+        if (error) asprintf (error, "Unknown rule field '%c'", c);
+        ok = FALSE;
+        }
+      p = strchr (p, '/');
+      p = p ? p + 1 : "";
+      }
+    if (ok && !(seen_b && seen_s))
+      {
+      if (error) asprintf (error, "Rule must have both B and S parts");
+      ok = FALSE;
+      }
+    }
+  else
+    {
+    // S/B or S/B/C
+    const char *slash = strchr (s, '/');
+    if (slash)
+      {
+      ok = rule_parse_digits (self, s, self->survive, 
+        self->survive_letters, self->survive_negate, error);
+      if (ok) ok = rule_parse_digits (self, slash + 1, self->birth, 
+        self->birth_letters, self->birth_negate, error);
+      const char *slash2 = strchr (slash + 1, '/');
+      if (ok && slash2)
+        ok = rule_parse_states (self, slash2 + 1, &self->states, error);
+      }
+    else
+      {
+      if (error) asprintf (error, "Rule must have both B and S parts");
+      ok = FALSE;
+      }
+    }
+
+  if (ok && self->family != RULE_FAMILY_LTL)
+    ok = rule_check_digits (self, error);
+
+  if (ok && self->hensel)
+    {
+    if (self->family == RULE_FAMILY_TOTALISTIC)
+      self->family = RULE_FAMILY_ISOTROPIC;
+    else
+      {
+      if (error) 
+        asprintf (error, "Hensel letters can only be used with the "
+          "Moore neighbourhood");
+      ok = FALSE;
+      }
+    }
+
+  if (!ok)
+    {
+    rule_destroy (self);
+    self = NULL;
+    }
+  else
+    rule_compile (self);
+
+  LOG_OUT
+  return self;
+  }
+
+
+/*==========================================================================
+  rule_clone
+*==========================================================================*/
+Rule *rule_clone (const Rule *other)
+  {
+  LOG_IN
+  Rule *self = malloc (sizeof (Rule));
+  memcpy (self, other, sizeof (Rule));
+  self->name = strdup (other->name);
+  self->table = malloc (other->states * other->stride);
+  memcpy (self->table, other->table, other->states * other->stride);
+  LOG_OUT
+  return self;
+  }
+
+
+/*==========================================================================
+  rule_destroy
+*==========================================================================*/
+void rule_destroy (Rule *self)
+  {
+  LOG_IN
+  if (self)
+    {
+    if (self->name) free (self->name);
+    if (self->table) free (self->table);
+    free (self);
+    }
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+  rule_get_name
+*==========================================================================*/
+const char *rule_get_name (const Rule *self)
+  {
+  return self->name;
+  }
+
+
+/*==========================================================================
+  rule_get_states
+*==========================================================================*/
+int rule_get_states (const Rule *self)
+  {
+  return self->states;
+  }
+
+
+/*==========================================================================
+  rule_get_table
+*==========================================================================*/
+const BYTE *rule_get_table (const Rule *self)
+  {
+  return self->table;
+  }
+
+
+/*==========================================================================
+  rule_get_table_stride
+
+  The number of transition table entries for each state
+*==========================================================================*/
+int rule_get_table_stride (const Rule *self)
+  {
+  return self->stride;
+  }
+
+
+/*==========================================================================
+  rule_get_family
+*==========================================================================*/
+RuleFamily rule_get_family (const Rule *self)
+  {
+  return self->family;
+  }
+
+
+/*==========================================================================
+  rule_get_radius
+
+  The radius of the neighbourhood -- 1 except for Larger than Life
+*==========================================================================*/
+int rule_get_radius (const Rule *self)
+  {
+  return self->radius;
+  }
+
@@ -0,0 +1,48 @@
+/*============================================================================
+
+  fblife
+  rule.h
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+============================================================================*/
+
+#pragma once
+
+#include "defs.h"
+
+// The largest radius for Larger than Life rules
+#define RULE_MAX_RADIUS 10
+
+typedef enum 
+  {
+  // Outer-totalistic rules on the Moore (radius 1) neighbourhood, 
+  //   including Generations rules
+  RULE_FAMILY_TOTALISTIC = 0,
+  // Outer-totalistic rules on the six neighbours of a hexagonal grid,
+  //   stored with alternate rows offset by half a cell
+  RULE_FAMILY_HEX,
+  // Outer-totalistic rules on the four orthogonal neighbours
+  RULE_FAMILY_VON_NEUMANN,
+  // Isotropic non-totalistic rules on the Moore neighbourhood
+  RULE_FAMILY_ISOTROPIC,
+  // Larger than Life -- totalistic rules on a radius-R box
+  RULE_FAMILY_LTL
+  } RuleFamily;
+
+struct _Rule;
+typedef struct _Rule Rule;
+
+BEGIN_DECLS
+
+Rule       *rule_parse (const char *s, char **error);
+Rule       *rule_clone (const Rule *other);
+void        rule_destroy (Rule *self);
+const char *rule_get_name (const Rule *self);
+int         rule_get_states (const Rule *self);
+const BYTE *rule_get_table (const Rule *self);
+int         rule_get_table_stride (const Rule *self);
+RuleFamily  rule_get_family (const Rule *self);
+int         rule_get_radius (const Rule *self);
+
+END_DECLS
+
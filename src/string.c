@@ -533,7 +533,7 @@ BOOL string_write_to_path (const String *self, const Path *path)
 *==========================================================================*/
 List *string_split (const String *self, const char *delim)
   {
-  List * l = list_create ((ListItemFreeFn)string_destroy);
+  List * l = list_create_unlocked ((ListItemFreeFn)string_destroy);
 
   char *s = strdup (self->str);
   
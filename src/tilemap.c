@@ -0,0 +1,219 @@
+/*============================================================================
+
+  fblife
+  tilemap.c
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  TileMap stores an unbounded grid of cells as square tiles, which are
+  created only when something needs to be stored in them. The tiles
+  are found by their tile coordinates using a hash table with chaining.
+  They are also kept in an array, so that they can be visited in turn
+  without walking the hash table. Visiting by index remains valid
+  while tiles are being added (new tiles go on the end) and, if the
+  iteration runs backwards, while the current tile is being removed
+  (the last tile is moved into its place).
+
+============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <stdint.h>
+#include "defs.h"
+#include "log.h"
+#include "tilemap.h"
+
+#define TILEMAP_INITIAL_BUCKETS 64
+
+struct _TileMap
+  {
+  Tile **buckets;
+  int nbuckets; // Always a power of two
+  Tile **tiles;
+  int count;
+  int capacity;
+  };
+
+
+/*==========================================================================
+  tilemap_hash
+*==========================================================================*/
+static inline unsigned int tilemap_hash (const TileMap *self, int tx, int ty)
+  {
+  uint32_t h = (uint32_t)tx * 0x9E3779B1u ^ (uint32_t)ty * 0x85EBCA77u;
+  h ^= h >> 15;
+  return h & (self->nbuckets - 1);
+  }
+
+
+/*==========================================================================
+  tilemap_create
+*==========================================================================*/
+TileMap *tilemap_create (void)
+  {
+  LOG_IN
+  TileMap *self = malloc (sizeof (TileMap));
+  self->nbuckets = TILEMAP_INITIAL_BUCKETS;
+  self->buckets = calloc (self->nbuckets, sizeof (Tile *));
+  self->capacity = TILEMAP_INITIAL_BUCKETS;
+  self->tiles = malloc (self->capacity * sizeof (Tile *));
+  self->count = 0;
+  LOG_OUT
+  return self;
+  }
+
+
+/*==========================================================================
+  tilemap_free_tile
+*==========================================================================*/
+static void tilemap_free_tile (Tile *tile)
+  {
+  free (tile->cells);
+  free (tile->new_cells);
+  free (tile);
+  }
+
+
+/*==========================================================================
+  tilemap_clear
+
+  Remove all the tiles
+*==========================================================================*/
+void tilemap_clear (TileMap *self)
+  {
+  LOG_IN
+  for (int i = 0; i < self->count; i++)
+    tilemap_free_tile (self->tiles[i]);
+  self->count = 0;
+  memset (self->buckets, 0, self->nbuckets * sizeof (Tile *));
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+  tilemap_destroy
+*==========================================================================*/
+void tilemap_destroy (TileMap *self)
+  {
+  LOG_IN
+  if (self)
+    {
+    tilemap_clear (self);
+    free (self->buckets);
+    free (self->tiles);
+    free (self);
+    }
+  LOG_OUT
+  }
+
+
+/*==========================================================================
+  tilemap_get
+
+  Returns NULL if there is no tile at these coordinates
+*==========================================================================*/
+Tile *tilemap_get (const TileMap *self, int tx, int ty)
+  {
+  Tile *tile = self->buckets [tilemap_hash (self, tx, ty)];
+  while (tile && (tile->tx != tx || tile->ty != ty))
+    tile = tile->next;
+  return tile;
+  }
+
+
+/*==========================================================================
+  tilemap_rehash
+
+  Double the number of buckets, and redistribute the tiles
+*==========================================================================*/
+static void tilemap_rehash (TileMap *self)
+  {
+  free (self->buckets);
+  self->nbuckets *= 2;
+  self->buckets = calloc (self->nbuckets, sizeof (Tile *));
+  for (int i = 0; i < self->count; i++)
+    {
+    Tile *tile = self->tiles[i];
+    unsigned int h = tilemap_hash (self, tile->tx, tile->ty);
+    tile->next = self->buckets[h];
+    self->buckets[h] = tile;
+    }
+  log_debug ("Tile map rehashed to %d buckets", self->nbuckets);
+  }
+
+
+/*==========================================================================
+  tilemap_get_or_create
+
+  Returns the tile at these coordinates, creating it, with all cells
+  dead, if there isn't one
+*==========================================================================*/
+Tile *tilemap_get_or_create (TileMap *self, int tx, int ty)
+  {
+  Tile *tile = tilemap_get (self, tx, ty);
+  if (tile) return tile;
+
+  int size = TILEMAP_TILE_SIZE * TILEMAP_TILE_SIZE;
+  tile = malloc (sizeof (Tile));
+  tile->tx = tx;
+  tile->ty = ty;
+  tile->cells = calloc (size, sizeof (BYTE));
+  tile->new_cells = calloc (size, sizeof (BYTE));
+  tile->occupied = 0;
+
+  if (self->count == self->capacity)
+    {
+    self->capacity *= 2;
+    self->tiles = realloc (self->tiles, self->capacity * sizeof (Tile *));
+    }
+  tile->index = self->count;
+  self->tiles [self->count++] = tile;
+
+  unsigned int h = tilemap_hash (self, tx, ty);
+  tile->next = self->buckets[h];
+  self->buckets[h] = tile;
+
+  if (self->count > self->nbuckets)
+    tilemap_rehash (self);
+  return tile;
+  }
+
+
+/*==========================================================================
+  tilemap_remove
+
+  Remove and free the tile. The last tile in the array takes its index
+*==========================================================================*/
+void tilemap_remove (TileMap *self, Tile *tile)
+  {
+  Tile **p = &self->buckets [tilemap_hash (self, tile->tx, tile->ty)];
+  while (*p != tile)
+    p = &(*p)->next;
+  *p = tile->next;
+
+  Tile *last = self->tiles [--self->count];
+  last->index = tile->index;
+  self->tiles [tile->index] = last;
+
+  tilemap_free_tile (tile);
+  }
+
+
+/*==========================================================================
+  tilemap_get_count
+*==========================================================================*/
+int tilemap_get_count (const TileMap *self)
+  {
+  return self->count;
+  }
+
+
+/*==========================================================================
+  tilemap_get_tile
+*==========================================================================*/
+Tile *tilemap_get_tile (const TileMap *self, int index)
+  {
+  return self->tiles [index];
+  }
+
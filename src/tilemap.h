@@ -0,0 +1,55 @@
+/*============================================================================
+
+  fblife
+  tilemap.h
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+============================================================================*/
+
+#pragma once
+
+#include "defs.h"
+
+// Tiles are square, and 2^TILEMAP_TILE_SHIFT cells on a side. The size
+//   is even, so row parity (which matters for hexagonal grids) is the 
+//   same in tile and universe coordinates
+#define TILEMAP_TILE_SHIFT 6
+#define TILEMAP_TILE_SIZE (1 << TILEMAP_TILE_SHIFT)
+
+// The tile coordinate that contains universe coordinate v, and the 
+//   offset of v within the tile. These rely on >> being an arithmetic
+//   shift for negative numbers, as it is with gcc
+#define TILEMAP_TILE_OF(v) ((v) >> TILEMAP_TILE_SHIFT)
+#define TILEMAP_OFFSET_OF(v) ((v) & (TILEMAP_TILE_SIZE - 1))
+
+// A tile holds the cells with universe coordinates from
+//   (tx * TILEMAP_TILE_SIZE, ty * TILEMAP_TILE_SIZE), in row order.
+//   Callers are free to read and write the cells, and to swap cells
+//   and new_cells
+typedef struct _Tile
+  {
+  int tx;
+  int ty;
+  BYTE *cells;
+  BYTE *new_cells;
+  int occupied; // Non-dead cells; maintained by the caller
+  int index; // Position in the tile map's array -- don't touch
+  struct _Tile *next; // Next in the same hash bucket -- don't touch
+  } Tile;
+
+struct _TileMap;
+typedef struct _TileMap TileMap;
+
+BEGIN_DECLS
+
+TileMap    *tilemap_create (void);
+void        tilemap_destroy (TileMap *self);
+Tile       *tilemap_get (const TileMap *self, int tx, int ty);
+Tile       *tilemap_get_or_create (TileMap *self, int tx, int ty);
+void        tilemap_remove (TileMap *self, Tile *tile);
+void        tilemap_clear (TileMap *self);
+int         tilemap_get_count (const TileMap *self);
+Tile       *tilemap_get_tile (const TileMap *self, int index);
+
+END_DECLS
+
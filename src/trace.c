@@ -0,0 +1,290 @@
+/*============================================================================
+
+  fblife
+  trace.c
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  A recorder of trace events, which can be written out in the Chrome
+  trace-event JSON format, and viewed in chrome://tracing or in
+  Perfetto (ui.perfetto.dev) as a timeline with a row for each thread.
+
+  Each event is a 'complete' event -- a name, and start and end times,
+  from CLOCK_MONOTONIC -- so that an event is whole even if the events
+  around it have been lost. Each thread that records events has its
+  own ring buffer of the last TRACE_BUFFER_EVENTS events, so recording
+  needs no locks: the thread writes the next slot, then publishes it
+  by incrementing the buffer's count. The buffer is allocated, and
+  added to the list of buffers, the first time a thread records an
+  event; that takes the lock, once per thread. Buffers stay on the
+  list after their threads end, so that their events can still be
+  written, up to TRACE_MAX_THREADS of them; after that, threads that
+  are new to tracing are not recorded.
+
+  trace_write() can be called while other threads are recording. It
+  reads each buffer's count before and after copying the events, and
+  leaves out any event that might have been overwritten in between.
+
+============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include "defs.h"
+#include "log.h"
+#include "feature.h"
+#include "trace.h"
+
+// Events kept for each thread; at 32 bytes each, this is 1Mb a thread
+#define TRACE_BUFFER_EVENTS 32768
+#define TRACE_MAX_THREADS 64
+#define TRACE_NAME_LENGTH 32
+
+BOOL trace_enabled = FALSE;
+
+#ifdef FEATURE_TRACE
+
+typedef struct _TraceEvent
+  {
+  const char *category;
+  const char *name;
+  int64_t start; // nsec
+  int64_t end;
+  } TraceEvent;
+
+typedef struct _TraceBuffer
+  {
+  pid_t tid;
+  char name [TRACE_NAME_LENGTH];
+  uint64_t count; // Events ever recorded; the latest is at count - 1
+  TraceEvent events [TRACE_BUFFER_EVENTS];
+  } TraceBuffer;
+
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuffer *trace_buffers [TRACE_MAX_THREADS];
+static int trace_nbuffers = 0;
+static int64_t trace_origin = 0;
+static __thread TraceBuffer *trace_buffer = NULL;
+static __thread BOOL trace_no_buffer = FALSE;
+
+
+/*==========================================================================
+
+  trace_get_buffer
+
+  The calling thread's buffer, which is created if need be. Returns
+  NULL if there are too many threads.
+
+*==========================================================================*/
+static TraceBuffer *trace_get_buffer (void)
+  {
+  if (trace_buffer || trace_no_buffer) return trace_buffer;
+  pthread_mutex_lock (&trace_mutex);
+  if (trace_nbuffers < TRACE_MAX_THREADS)
+    {
+    TraceBuffer *buffer = malloc (sizeof (TraceBuffer));
+    buffer->tid = syscall (SYS_gettid);
+    snprintf (buffer->name, sizeof (buffer->name), "thread %d",
+      (int)buffer->tid);
+    buffer->count = 0;
+    trace_buffers [trace_nbuffers++] = buffer;
+    trace_buffer = buffer;
+    }
+  else
+    trace_no_buffer = TRUE;
+  pthread_mutex_unlock (&trace_mutex);
+  return trace_buffer;
+  }
+
+#endif
+
+
+/*==========================================================================
+
+  trace_start
+
+  Turn tracing on. This should be done before any other threads are
+  started, since they don't lock trace_enabled. Returns FALSE, and
+  sets error, if the program was built without FEATURE_TRACE.
+
+*==========================================================================*/
+BOOL trace_start (char **error)
+  {
+  LOG_IN
+#ifdef FEATURE_TRACE
+  if (!trace_enabled)
+    {
+    trace_origin = trace_now();
+    trace_enabled = TRUE;
+    trace_thread_name ("main");
+    }
+  LOG_OUT
+  return TRUE;
+#else
+  if (error)
+    *error = strdup ("Tracing is not included in this build");
+  LOG_OUT
+  return FALSE;
+#endif
+  }
+
+
+/*==========================================================================
+
+  trace_now
+
+  CLOCK_MONOTONIC in nsec; never zero, which TRACE_BEGIN uses to mean
+  that tracing is off
+
+*==========================================================================*/
+int64_t trace_now (void)
+  {
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  }
+
+
+/*==========================================================================
+
+  trace_complete
+
+  Record an event that started at start, and ends now
+
+*==========================================================================*/
+void trace_complete (const char *category, const char *name,
+       int64_t start)
+  {
+#ifdef FEATURE_TRACE
+  TraceBuffer *buffer = trace_get_buffer();
+  if (buffer)
+    {
+    uint64_t count = buffer->count;
+    TraceEvent *event = &buffer->events [count % TRACE_BUFFER_EVENTS];
+    event->category = category;
+    event->name = name;
+    event->start = start;
+    event->end = trace_now();
+    __atomic_store_n (&buffer->count, count + 1, __ATOMIC_RELEASE);
+    }
+#endif
+  }
+
+
+/*==========================================================================
+
+  trace_thread_name
+
+  Name the calling thread, in the trace. The name is copied, and
+  truncated if it is too long.
+
+*==========================================================================*/
+void trace_thread_name (const char *name)
+  {
+#ifdef FEATURE_TRACE
+  TraceBuffer *buffer = trace_get_buffer();
+  if (buffer)
+    {
+    pthread_mutex_lock (&trace_mutex);
+    snprintf (buffer->name, sizeof (buffer->name), "%s", name);
+    pthread_mutex_unlock (&trace_mutex);
+    }
+#endif
+  }
+
+
+#ifdef FEATURE_TRACE
+/*==========================================================================
+
+  trace_write_buffer
+
+  Write one thread's events, copying them first so that they can be
+  checked. Returns FALSE if writing fails.
+
+*==========================================================================*/
+static BOOL trace_write_buffer (FILE *f, const TraceBuffer *buffer,
+       TraceEvent *copy, pid_t pid)
+  {
+  BOOL ok = fprintf (f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+    "\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", (int)pid,
+    (int)buffer->tid, buffer->name) > 0;
+
+  uint64_t end = __atomic_load_n (&buffer->count, __ATOMIC_ACQUIRE);
+  uint64_t first = end > TRACE_BUFFER_EVENTS ? end - TRACE_BUFFER_EVENTS : 0;
+  for (uint64_t i = first; i < end; i++)
+    copy [i - first] = buffer->events [i % TRACE_BUFFER_EVENTS];
+  // The event with index i is overwritten when the one with index
+  //   i + TRACE_BUFFER_EVENTS is recorded
+  uint64_t now = __atomic_load_n (&buffer->count, __ATOMIC_ACQUIRE);
+  uint64_t safe = now >= TRACE_BUFFER_EVENTS
+    ? now - TRACE_BUFFER_EVENTS + 1 : 0;
+
+  for (uint64_t i = first > safe ? first : safe; ok && i < end; i++)
+    {
+    const TraceEvent *event = &copy [i - first];
+    ok = fprintf (f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+      "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}", event->name,
+      event->category, (event->start - trace_origin) / 1e3,
+      (event->end - event->start) / 1e3, (int)pid,
+      (int)buffer->tid) > 0;
+    }
+  return ok;
+  }
+#endif
+
+
+/*==========================================================================
+
+  trace_write
+
+  Write all the events that have been recorded, and are still in the
+  buffers, as a Chrome trace-event JSON file. Returns FALSE, and sets
+  error, if the file can't be written, or tracing is not on.
+
+*==========================================================================*/
+BOOL trace_write (const char *filename, char **error)
+  {
+  LOG_IN
+  BOOL ret = FALSE;
+#ifdef FEATURE_TRACE
+  FILE *f = NULL;
+  if (!trace_enabled)
+    {
+    if (error) *error = strdup ("Tracing is not turned on");
+    }
+  else if ((f = fopen (filename, "w")) == NULL)
+    {
+    if (error)
+      asprintf (error, "Can't write %s: %s", filename, strerror (errno));
+    }
+  else
+    {
+    pid_t pid = getpid();
+    ret = fprintf (f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+      "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+      "\"args\":{\"name\":\"%s\"}}", (int)pid, NAME) > 0;
+    TraceEvent *copy = malloc (TRACE_BUFFER_EVENTS * sizeof (TraceEvent));
+    pthread_mutex_lock (&trace_mutex);
+    for (int i = 0; ret && i < trace_nbuffers; i++)
+      ret = trace_write_buffer (f, trace_buffers[i], copy, pid);
+    pthread_mutex_unlock (&trace_mutex);
+    free (copy);
+    ret = ret && fprintf (f, "\n]}\n") > 0;
+    if (fclose (f) != 0) ret = FALSE;
+    if (!ret && error)
+      asprintf (error, "Can't write %s: %s", filename, strerror (errno));
+    }
+#else
+  if (error)
+    *error = strdup ("Tracing is not included in this build");
+#endif
+  LOG_OUT
+  return ret;
+  }
+
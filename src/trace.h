@@ -0,0 +1,46 @@
+/*============================================================================
+
+  fblife
+  trace.h
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  Trace points. Put TRACE_BEGIN(t) at the start of something to be
+  timed, and TRACE_END(t, category, name) at the end, in the same
+  block; category and name must be string literals, or at least must
+  outlive the trace. When tracing is not turned on, a trace point
+  costs a test of trace_enabled; when the program is built without
+  FEATURE_TRACE, it costs nothing at all.
+
+============================================================================*/
+
+#pragma once
+
+#include <stdint.h>
+#include "defs.h"
+#include "feature.h"
+
+extern BOOL trace_enabled;
+
+BEGIN_DECLS
+
+BOOL        trace_start (char **error);
+int64_t     trace_now (void);
+void        trace_complete (const char *category, const char *name,
+              int64_t start);
+void        trace_thread_name (const char *name);
+BOOL        trace_write (const char *filename, char **error);
+
+END_DECLS
+
+#ifdef FEATURE_TRACE
+#define TRACE_BEGIN(t) int64_t t = trace_enabled ? trace_now() : 0
+#define TRACE_END(t, category, name) \
+  do { if (t) trace_complete (category, name, t); } while (0)
+#define TRACE_THREAD_NAME(name) \
+  do { if (trace_enabled) trace_thread_name (name); } while (0)
+#else
+#define TRACE_BEGIN(t)
+#define TRACE_END(t, category, name)
+#define TRACE_THREAD_NAME(name)
+#endif
+
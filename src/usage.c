@@ -26,16 +26,36 @@ void usage_show (FILE *fout, const char *argv0)
   fprintf (fout, "  -b,--border-colour=c border colour name or code (cyan)\n");
   fprintf (fout, "     --b-rule=NNN      cell birth rule (3)\n");
   fprintf (fout, "  -c,--colour=c        colour name or code (lime)\n");
+  fprintf (fout, "     --control=PATH    accept commands on a socket\n");
+  fprintf (fout, "     --direct          draw plain cells straight to screen\n");
   fprintf (fout, "  -e,--erase           clear framebuffer first\n");
-  fprintf (fout, "  -f,--fbdev=device    framebuffer device (/dev/fb0)\n");
+  fprintf (fout, "  -f,--fbdev=dev[,...] framebuffer device(s) (/dev/fb0)\n");
+  fprintf (fout, "     --follow          keep live cells in view (unbounded)\n");
+  fprintf (fout, "  -g,--generations-per-frame=N  generations per frame (1)\n");
+  fprintf (fout, "     --generations=N   generations before a snapshot (100)\n");
   fprintf (fout, "  -h,--height=N        height in cells (20)\n");
   fprintf (fout, "     --log-level=N     log level, 0-5 (default 2)\n");
+  fprintf (fout, "     --idle-interval=N longest msec between idle cycles (8000)\n");
+  fprintf (fout, "     --idle-threshold=N  slow down if fewer cells change (0)\n");
   fprintf (fout, "  -i,--interval=N      msec between cycles (1000)\n");
   fprintf (fout, "  -m,--max-cycles=N    maximum number of cycles (60)\n");
+  fprintf (fout, "     --metrics         publish metrics in /dev/shm\n");
+  fprintf (fout, "     --pattern=FILE    start from an RLE pattern file\n");
+  fprintf (fout, "     --perf-counters   log CPU performance counters\n");
   fprintf (fout, "  -p,--percent=N       initial percentage (30)\n");
+  fprintf (fout, "     --record=PATH     record frames to file, or |command\n");
+  fprintf (fout, "     --record-format=F rgb or y4m (from file extension)\n");
+  fprintf (fout, "  -r,--rule=RULE       full rule, e.g., B3/S23 or B2/S/C3\n");
+  fprintf (fout, "     --scale=N         magnify the display N times (1)\n");
   fprintf (fout, "  -s,--cell-size=N     cell size in pixels (20)  \n");
+  fprintf (fout, "     --seed=N          random number seed (time)\n");
+  fprintf (fout, "     --snapshot=FILE   write an image (.ppm, .png) and exit\n");
+  fprintf (fout, "     --snapshot-count=N  number of snapshots, FILE has %%d (1)\n");
   fprintf (fout, "     --s-rule=NNN      cell survival rule (23)\n");
+  fprintf (fout, "     --topology=T      torus, plane, klein, cross, unbounded\n");
+  fprintf (fout, "     --trace=FILE      write a timeline, in Chrome JSON format\n");
   fprintf (fout, "  -v,--version         show version\n");
+  fprintf (fout, "     --watch-rc        reload settings when RC files change\n");
   fprintf (fout, "  -w,--width=N         width in cells (20)\n");
   fprintf (fout, "  -x,--x=N             display x position (centre)\n");
   fprintf (fout, "  -y,--y=N             display y position (centre)\n");
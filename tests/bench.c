@@ -0,0 +1,484 @@
+/*============================================================================
+
+  fblife
+  tests/bench.c
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  Benchmarks for the Life engine, for "make bench". For every
+  combination of grid size, density, rule, topology and number of
+  threads, it times these kernels:
+
+    seed    life_seed(), filling the grid at random
+    update  life_update(), one generation at a time
+    step_n  life_step_n(), many generations at a time -- the blocked
+            path, where the grid is large enough (see life.c)
+
+  The rule picks the neighbour-counting and rule-evaluation code that
+  runs: Moore, von Neumann, hexagonal, isotropic non-totalistic,
+  Generations, and Larger than Life rules each have their own.
+
+  Each measurement runs enough generations to cover a fixed number of
+  cells (the "budget"), so small grids are not just timing overheads;
+  but step_n always runs at least BENCH_MIN_STEP_N generations, so 
+  that the largest grids are still stepped in blocks.
+  It is run once or more without timing, to warm up the caches and
+  let the soup settle, then timed several times; the best and the
+  median times are reported, in nanoseconds per cell per generation.
+  With more than one thread, each thread runs its own grid, as each
+  panel of the display does, and the time is that for all of them, so
+  the figure shows how much work the machine gets through in total.
+
+  A random soup may die out or become stable, at which point
+  life_step_n() stops early. When that happens, the soup is reseeded
+  and the generations since the last check are not counted.
+
+  Usage: bench [-c] [-s sizes] [-d densities] [-r rules] [-t topologies]
+               [-j threads] [-k kernels] [-b budget] [-w warmups]
+               [-n repeats]
+
+  Lists are comma-separated, except rules, which contain commas and are
+  separated by ';'. A size is N, for N x N, or W x H. -c writes CSV
+  instead of a table.
+
+============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include "defs.h"
+#include "log.h"
+#include "rule.h"
+#include "life.h"
+
+#define BENCH_DEF_SIZES "64,256,1024,4096,16384"
+#define BENCH_DEF_DENSITIES "10,30,50"
+#define BENCH_DEF_RULES "B3/S23;B2/S3V;B2/S34H;B2-a/S12;B2/S345/C4;" \
+  "R5,C0,M1,S34..58,B34..45,NM"
+#define BENCH_DEF_TOPOLOGIES "torus"
+#define BENCH_DEF_THREADS "1"
+#define BENCH_DEF_KERNELS "seed,update,step_n"
+// Cells (times generations) in each measurement
+#define BENCH_DEF_BUDGET (16 * 1024 * 1024)
+#define BENCH_DEF_WARMUPS 1
+#define BENCH_DEF_REPEATS 3
+// The fewest generations for step_n, so that large grids are still
+//   stepped in blocks, which takes several generations at a time
+#define BENCH_MIN_STEP_N 8
+// Generations between checks for a soup that has died out
+#define BENCH_CHUNK 64
+// Give up on a soup that keeps dying out before the next check
+#define BENCH_MAX_RESEEDS 20
+#define BENCH_MAX_LIST 32
+
+typedef enum
+  {
+  BENCH_SEED = 0,
+  BENCH_UPDATE,
+  BENCH_STEP_N
+  } BenchKernel;
+
+static const char *bench_kernel_names[] = { "seed", "update", "step_n" };
+
+typedef struct _BenchOptions
+  {
+  double budget;
+  int warmups;
+  int repeats;
+  BOOL csv;
+  } BenchOptions;
+
+// One thread's share of a measurement
+typedef struct _BenchWorker
+  {
+  Life *life;
+  BenchKernel kernel;
+  int density;
+  int generations;
+  pthread_barrier_t *barrier;
+  double elapsed; // Seconds, or negative if the soup kept dying
+  BOOL stop;
+  pthread_t thread;
+  } BenchWorker;
+
+
+/*==========================================================================
+  bench_now
+*==========================================================================*/
+static double bench_now (void)
+  {
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+  }
+
+
+/*==========================================================================
+
+  bench_run_kernel
+
+  Run the kernel once on the worker's grid, and return the time it
+  took, not counting any reseeding, or a negative number if the soup
+  kept dying out
+
+*==========================================================================*/
+static double bench_run_kernel (BenchWorker *w)
+  {
+  if (w->kernel == BENCH_SEED)
+    {
+    double start = bench_now();
+    life_seed (w->life, w->density);
+    return bench_now() - start;
+    }
+
+  double elapsed = 0;
+  int done = 0, reseeds = 0;
+  while (done < w->generations)
+    {
+    int n = w->generations - done;
+    if (n > BENCH_CHUNK) n = BENCH_CHUNK;
+    BOOL live = TRUE;
+    double start = bench_now();
+    if (w->kernel == BENCH_STEP_N)
+      live = life_step_n (w->life, n);
+    else
+      for (int i = 0; i < n; i++)
+        live = life_update (w->life) && live;
+    double t = bench_now() - start;
+    if (live)
+      {
+      elapsed += t;
+      done += n;
+      reseeds = 0;
+      }
+    else
+      {
+      if (++reseeds > BENCH_MAX_RESEEDS) return -1;
+      life_seed (w->life, w->density);
+      }
+    }
+  return elapsed;
+  }
+
+
+/*==========================================================================
+
+  bench_worker
+
+  Wait at the barrier for each run, do it, then wait again for the
+  main thread to collect the time, until told to stop
+
+*==========================================================================*/
+static void *bench_worker (void *arg)
+  {
+  BenchWorker *w = arg;
+  for (;;)
+    {
+    pthread_barrier_wait (w->barrier);
+    if (w->stop) break;
+    w->elapsed = bench_run_kernel (w);
+    pthread_barrier_wait (w->barrier);
+    }
+  return NULL;
+  }
+
+
+/*==========================================================================
+  bench_compare
+*==========================================================================*/
+static int bench_compare (const void *a, const void *b)
+  {
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+  }
+
+
+/*==========================================================================
+
+  bench_measure
+
+  Time one kernel on nthreads grids of the given size, warmups times
+  without timing and then repeats times. Sets best and median, in
+  nanoseconds per cell per generation, or to NAN if the soup kept
+  dying out.
+
+*==========================================================================*/
+static void bench_measure (BenchKernel kernel, const Rule *rule,
+       LifeTopology topology, int w, int h, int density, int nthreads,
+       int generations, int warmups, int repeats, double *best,
+       double *median)
+  {
+  BenchWorker *workers = calloc (nthreads, sizeof (BenchWorker));
+  pthread_barrier_t barrier;
+  pthread_barrier_init (&barrier, NULL, nthreads + 1);
+  for (int i = 0; i < nthreads; i++)
+    {
+    BenchWorker *wk = &workers[i];
+    wk->life = life_create (w, h, rule, topology);
+    srand (i + 1);
+    life_seed (wk->life, density);
+    wk->kernel = kernel;
+    wk->density = density;
+    wk->generations = kernel == BENCH_SEED ? 1 : generations;
+    wk->barrier = &barrier;
+    pthread_create (&wk->thread, NULL, bench_worker, wk);
+    }
+
+  double *times = malloc (repeats * sizeof (double));
+  BOOL died = FALSE;
+  for (int run = 0; run < warmups + repeats; run++)
+    {
+    pthread_barrier_wait (&barrier);
+    pthread_barrier_wait (&barrier);
+    double slowest = 0;
+    for (int i = 0; i < nthreads; i++)
+      {
+      if (workers[i].elapsed < 0) died = TRUE;
+      if (workers[i].elapsed > slowest) slowest = workers[i].elapsed;
+      }
+    if (run >= warmups)
+      times [run - warmups] = slowest;
+    }
+
+  for (int i = 0; i < nthreads; i++)
+    workers[i].stop = TRUE;
+  pthread_barrier_wait (&barrier);
+  for (int i = 0; i < nthreads; i++)
+    {
+    pthread_join (workers[i].thread, NULL);
+    life_destroy (workers[i].life);
+    }
+  pthread_barrier_destroy (&barrier);
+
+  qsort (times, repeats, sizeof (double), bench_compare);
+  double cells = (double)w * h * nthreads * workers[0].generations;
+  *best = died ? NAN : times[0] * 1e9 / cells;
+  *median = died ? NAN : times [repeats / 2] * 1e9 / cells;
+  free (times);
+  free (workers);
+  }
+
+
+/*==========================================================================
+
+  bench_split
+
+  Split a list in place, at the given separator, into at most
+  BENCH_MAX_LIST items. Returns the number of items.
+
+*==========================================================================*/
+static int bench_split (char *list, const char *sep, char **items)
+  {
+  int n = 0;
+  char *saveptr = NULL;
+  for (char *s = strtok_r (list, sep, &saveptr); s && n < BENCH_MAX_LIST;
+       s = strtok_r (NULL, sep, &saveptr))
+    items[n++] = s;
+  return n;
+  }
+
+
+/*==========================================================================
+
+  bench_report
+
+  Measure one combination of settings, and print the result
+
+*==========================================================================*/
+static void bench_report (BenchKernel kernel, const char *rule_name, 
+       const Rule *rule, const char *topology_name, LifeTopology topology, 
+       int w, int h, int density, int nthreads, const BenchOptions *opts)
+  {
+  int generations = 1;
+  if (kernel != BENCH_SEED)
+    {
+    generations = opts->budget / ((double)w * h);
+    if (generations < 1) generations = 1;
+    if (kernel == BENCH_STEP_N && generations < BENCH_MIN_STEP_N) 
+      generations = BENCH_MIN_STEP_N;
+    }
+  else
+    {
+    // Seeding does not depend on the rule or topology
+    rule_name = "-";
+    topology_name = "-";
+    }
+
+  double best, median;
+  bench_measure (kernel, rule, topology, w, h, density, nthreads,
+    generations, opts->warmups, opts->repeats, &best, &median);
+  if (opts->csv)
+    printf ("%s,\"%s\",%s,%d,%d,%d,%d,%d,%.3f,%.3f\n",
+      bench_kernel_names[kernel], rule_name, topology_name, w, h,
+      density, nthreads, generations, best, median);
+  else
+    printf ("%-7s %-28s %-9s %5dx%-5d %4d %3d %6d %9.3f %9.3f\n",
+      bench_kernel_names[kernel], rule_name, topology_name, w, h,
+      density, nthreads, generations, best, median);
+  fflush (stdout);
+  }
+
+
+/*==========================================================================
+  bench_usage
+*==========================================================================*/
+static void bench_usage (const char *argv0)
+  {
+  fprintf (stderr, "Usage: %s [options]\n", argv0);
+  fprintf (stderr, "  -b N       cells x generations per run (%d)\n",
+    BENCH_DEF_BUDGET);
+  fprintf (stderr, "  -c         write CSV\n");
+  fprintf (stderr, "  -d LIST    percent densities (%s)\n",
+    BENCH_DEF_DENSITIES);
+  fprintf (stderr, "  -j LIST    threads (%s)\n", BENCH_DEF_THREADS);
+  fprintf (stderr, "  -k LIST    kernels (%s)\n", BENCH_DEF_KERNELS);
+  fprintf (stderr, "  -n N       timed runs (%d)\n", BENCH_DEF_REPEATS);
+  fprintf (stderr, "  -r LIST    rules, separated by ';'\n");
+  fprintf (stderr, "  -s LIST    sizes, N or WxH (%s)\n", BENCH_DEF_SIZES);
+  fprintf (stderr, "  -t LIST    topologies (%s)\n", BENCH_DEF_TOPOLOGIES);
+  fprintf (stderr, "  -w N       untimed runs first (%d)\n",
+    BENCH_DEF_WARMUPS);
+  }
+
+
+/*==========================================================================
+  main
+*==========================================================================*/
+int main (int argc, char **argv)
+  {
+  char *sizes = strdup (BENCH_DEF_SIZES);
+  char *densities = strdup (BENCH_DEF_DENSITIES);
+  char *rules = strdup (BENCH_DEF_RULES);
+  char *topologies = strdup (BENCH_DEF_TOPOLOGIES);
+  char *threads = strdup (BENCH_DEF_THREADS);
+  char *kernels = strdup (BENCH_DEF_KERNELS);
+  BenchOptions opts = { BENCH_DEF_BUDGET, BENCH_DEF_WARMUPS, 
+    BENCH_DEF_REPEATS, FALSE };
+  int opt;
+  while ((opt = getopt (argc, argv, "b:cd:j:k:n:r:s:t:w:")) != -1)
+    {
+    switch (opt)
+      {
+      case 'b': opts.budget = atof (optarg); break;
+      case 'c': opts.csv = TRUE; break;
+      case 'd': free (densities); densities = strdup (optarg); break;
+      case 'j': free (threads); threads = strdup (optarg); break;
+      case 'k': free (kernels); kernels = strdup (optarg); break;
+      case 'n': opts.repeats = atoi (optarg); break;
+      case 'r': free (rules); rules = strdup (optarg); break;
+      case 's': free (sizes); sizes = strdup (optarg); break;
+      case 't': free (topologies); topologies = strdup (optarg); break;
+      case 'w': opts.warmups = atoi (optarg); break;
+      default: bench_usage (argv[0]); return 2;
+      }
+    }
+  if (opts.repeats < 1 || opts.warmups < 0 || opts.budget < 1)
+    {
+    bench_usage (argv[0]);
+    return 2;
+    }
+
+  char *size_list[BENCH_MAX_LIST], *density_list[BENCH_MAX_LIST];
+  char *rule_list[BENCH_MAX_LIST], *topology_list[BENCH_MAX_LIST];
+  char *thread_list[BENCH_MAX_LIST], *kernel_list[BENCH_MAX_LIST];
+  int nsizes = bench_split (sizes, ",", size_list);
+  int ndensities = bench_split (densities, ",", density_list);
+  int nrules = bench_split (rules, ";", rule_list);
+  int ntopologies = bench_split (topologies, ",", topology_list);
+  int nthreads = bench_split (threads, ",", thread_list);
+  int nkernels = bench_split (kernels, ",", kernel_list);
+
+  // Check everything first, rather than fail half way through
+  int ret = 0;
+  Rule *rule_objs[BENCH_MAX_LIST];
+  LifeTopology topology_ids[BENCH_MAX_LIST];
+  BenchKernel kernel_ids[BENCH_MAX_LIST];
+  int ws[BENCH_MAX_LIST], hs[BENCH_MAX_LIST];
+  for (int i = 0; i < nrules; i++)
+    {
+    char *error = NULL;
+    rule_objs[i] = rule_parse (rule_list[i], &error);
+    if (rule_objs[i] == NULL)
+      {
+      fprintf (stderr, "Bad rule %s: %s\n", rule_list[i], error);
+      free (error);
+      ret = 2;
+      }
+    }
+  for (int i = 0; i < ntopologies; i++)
+    if (!life_parse_topology (topology_list[i], &topology_ids[i]))
+      {
+      fprintf (stderr, "Unknown topology: %s\n", topology_list[i]);
+      ret = 2;
+      }
+  for (int i = 0; i < nkernels; i++)
+    {
+    kernel_ids[i] = BENCH_SEED;
+    while (kernel_ids[i] <= BENCH_STEP_N && strcmp (kernel_list[i],
+        bench_kernel_names [kernel_ids[i]]) != 0)
+      kernel_ids[i]++;
+    if (kernel_ids[i] > BENCH_STEP_N)
+      {
+      fprintf (stderr, "Unknown kernel: %s\n", kernel_list[i]);
+      ret = 2;
+      }
+    }
+  for (int i = 0; i < nsizes; i++)
+    {
+    if (sscanf (size_list[i], "%dx%d", &ws[i], &hs[i]) != 2)
+      hs[i] = ws[i] = atoi (size_list[i]);
+    if (ws[i] < 1 || hs[i] < 1)
+      {
+      fprintf (stderr, "Bad size: %s\n", size_list[i]);
+      ret = 2;
+      }
+    }
+  if (nrules == 0 || ntopologies == 0) ret = 2;
+
+  if (ret == 0)
+    {
+    if (opts.csv)
+      printf ("kernel,rule,topology,width,height,density,threads,"
+        "generations,best_ns_per_cell,median_ns_per_cell\n");
+    else
+      printf ("%-7s %-28s %-9s %11s %4s %3s %6s %9s %9s\n", "kernel",
+        "rule", "topology", "size", "%", "thr", "gens", "best ns",
+        "median ns");
+    }
+
+  for (int k = 0; k < nkernels && ret == 0; k++)
+    {
+    BenchKernel kernel = kernel_ids[k];
+    // Seeding does not depend on the rule or topology, and uses 
+    //   rand(), which the threads would have to share
+    int nr = kernel == BENCH_SEED ? 1 : nrules;
+    int nt = kernel == BENCH_SEED ? 1 : ntopologies;
+    for (int r = 0; r < nr; r++)
+      for (int t = 0; t < nt; t++)
+        for (int s = 0; s < nsizes; s++)
+          for (int d = 0; d < ndensities; d++)
+            for (int j = 0; j < nthreads; j++)
+              {
+              int n = atoi (thread_list[j]);
+              if (n < 1 || (kernel == BENCH_SEED && n > 1)) continue;
+              bench_report (kernel, rule_list[r], rule_objs[r], 
+                topology_list[t], topology_ids[t], ws[s], hs[s], 
+                atoi (density_list[d]), n, &opts);
+              }
+    }
+
+  for (int i = 0; i < nrules; i++)
+    if (rule_objs[i]) rule_destroy (rule_objs[i]);
+  free (sizes);
+  free (densities);
+  free (rules);
+  free (topologies);
+  free (threads);
+  free (kernels);
+  return ret;
+  }
+
@@ -0,0 +1,334 @@
+/*============================================================================
+
+  fblife
+  tests/bench_render.c
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  Benchmarks for the drawing code, for "make bench-render". These
+  time the Region and FrameBuffer operations that each frame goes
+  through, on a framebuffer in memory (framebuffer_create_memory), at
+  several screen sizes and pixel depths:
+
+    fill_rect     region_fill_rect() over the whole region
+    draw_rect     region_draw_rect() around each cell of a grid of
+                  BENCH_RENDER_CELL pixel cells, as panel_draw() does
+    to_fb         region_to_fb(), a whole-screen region
+    to_fb_scaled  region_to_fb_scaled(), a half-size region, doubled
+    from_fb       region_from_fb(), a whole-screen region
+    clear         framebuffer_clear()
+
+  The two region operations do not involve the framebuffer, so they
+  are timed once for each size, not for each depth.
+
+  Each operation is done once, untimed, to warm up the caches and to
+  see how long it takes; it is then repeated enough times to take 
+  about BENCH_RENDER_DEF_MSEC milliseconds, for each of several timed
+  runs, and the best run is reported. Throughput is given as pixels
+  per second, and as GB/s of pixel data written (or, for from_fb,
+  read) at the destination (or source) -- three bytes a pixel for a
+  Region, and the framebuffer's own pixel size for the framebuffer.
+
+  Usage: bench_render [-c] [-s sizes] [-d depths] [-o operations]
+                      [-m msec] [-n runs]
+
+  Lists are comma-separated; a size is W x H, like 800x480. -c writes
+  CSV instead of a table.
+
+============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "defs.h"
+#include "log.h"
+#include "region.h"
+#include "framebuffer.h"
+
+#define BENCH_RENDER_DEF_SIZES "320x240,480x320,800x480,1280x720,1920x1080"
+#define BENCH_RENDER_DEF_DEPTHS "16,24,32"
+#define BENCH_RENDER_DEF_OPS \
+  "fill_rect,draw_rect,to_fb,to_fb_scaled,from_fb,clear"
+// Time for each run
+#define BENCH_RENDER_DEF_MSEC 200
+#define BENCH_RENDER_DEF_RUNS 5
+// Size of the cells for draw_rect, as the default cell size
+#define BENCH_RENDER_CELL 20
+#define BENCH_RENDER_MAX_LIST 32
+
+typedef enum
+  {
+  BENCH_RENDER_FILL_RECT = 0,
+  BENCH_RENDER_DRAW_RECT,
+  BENCH_RENDER_TO_FB,
+  BENCH_RENDER_TO_FB_SCALED,
+  BENCH_RENDER_FROM_FB,
+  BENCH_RENDER_CLEAR,
+  BENCH_RENDER_NOPS
+  } BenchRenderOp;
+
+static const char *bench_render_op_names[] =
+  { "fill_rect", "draw_rect", "to_fb", "to_fb_scaled", "from_fb", "clear" };
+
+
+/*==========================================================================
+  bench_render_now
+*==========================================================================*/
+static double bench_render_now (void)
+  {
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+  }
+
+
+/*==========================================================================
+
+  bench_render_do
+
+  Do the operation once
+
+*==========================================================================*/
+static void bench_render_do (BenchRenderOp op, Region *region,
+       Region *half, FrameBuffer *fb)
+  {
+  int w = region_get_width (region), h = region_get_height (region);
+  switch (op)
+    {
+    case BENCH_RENDER_FILL_RECT:
+      region_fill_rect (region, 0, 0, w, h, 0, 255, 0);
+      break;
+    case BENCH_RENDER_DRAW_RECT:
+      for (int y = 0; y + BENCH_RENDER_CELL <= h; y += BENCH_RENDER_CELL)
+        for (int x = 0; x + BENCH_RENDER_CELL <= w; x += BENCH_RENDER_CELL)
+          region_draw_rect (region, x, y, x + BENCH_RENDER_CELL - 2,
+            y + BENCH_RENDER_CELL - 2, 0, 255, 255);
+      break;
+    case BENCH_RENDER_TO_FB:
+      region_to_fb (region, fb, 0, 0);
+      break;
+    case BENCH_RENDER_TO_FB_SCALED:
+      region_to_fb_scaled (half, fb, 0, 0, 2);
+      break;
+    case BENCH_RENDER_FROM_FB:
+      region_from_fb (region, fb, 0, 0);
+      break;
+    case BENCH_RENDER_CLEAR:
+      framebuffer_clear (fb);
+      break;
+    default:
+      break;
+    }
+  }
+
+
+/*==========================================================================
+
+  bench_render_pixels
+
+  The number of pixels that the operation writes (or, for from_fb,
+  reads from the framebuffer)
+
+*==========================================================================*/
+static double bench_render_pixels (BenchRenderOp op, int w, int h)
+  {
+  switch (op)
+    {
+    case BENCH_RENDER_DRAW_RECT:
+      {
+      // Each outline is BENCH_RENDER_CELL - 2 pixels square
+      double cells = (double)(w / BENCH_RENDER_CELL)
+        * (h / BENCH_RENDER_CELL);
+      return cells * (4 * (BENCH_RENDER_CELL - 2) - 4);
+      }
+    case BENCH_RENDER_TO_FB_SCALED:
+      return (double)(w / 2 * 2) * (h / 2 * 2);
+    default:
+      return (double)w * h;
+    }
+  }
+
+
+/*==========================================================================
+
+  bench_render_measure
+
+  Time an operation at one size and depth, and print the result.
+  depth is 0 for the operations that only involve a Region.
+
+*==========================================================================*/
+static void bench_render_measure (BenchRenderOp op, int w, int h,
+       int depth, int msec, int runs, BOOL csv)
+  {
+  Region *region = region_create (w, h);
+  Region *half = region_create (w / 2, h / 2);
+  region_fill_rect (region, 0, 0, w, h, 40, 80, 160);
+  region_fill_rect (half, 0, 0, w / 2, h / 2, 40, 80, 160);
+  FrameBuffer *fb = depth ? framebuffer_create_memory (w, h, depth) : NULL;
+
+  double pixels = bench_render_pixels (op, w, h);
+  double bytes = pixels * (depth && op >= BENCH_RENDER_TO_FB
+    ? depth / 8 : 3);
+  double start = bench_render_now();
+  bench_render_do (op, region, half, fb);
+  int repeats = msec / 1e3 / (bench_render_now() - start);
+  if (repeats < 1) repeats = 1;
+
+  double best = 0;
+  for (int run = 0; run < runs; run++)
+    {
+    start = bench_render_now();
+    for (int i = 0; i < repeats; i++)
+      bench_render_do (op, region, half, fb);
+    double t = (bench_render_now() - start) / repeats;
+    if (run == 0 || t < best) best = t;
+    }
+
+  double mpixels = pixels / best / 1e6;
+  double gbytes = bytes / best / 1e9;
+  if (csv)
+    printf ("%s,%d,%d,%d,%d,%.4f,%.2f,%.3f\n", bench_render_op_names[op],
+      w, h, depth, repeats, best * 1e3, mpixels, gbytes);
+  else
+    {
+    char d[8] = "-";
+    if (depth) snprintf (d, sizeof (d), "%d", depth);
+    printf ("%-13s %5dx%-5d %3s %7d %10.4f %10.2f %8.3f\n",
+      bench_render_op_names[op], w, h, d, repeats, best * 1e3, mpixels,
+      gbytes);
+    }
+  fflush (stdout);
+
+  if (fb) framebuffer_destroy (fb);
+  region_destroy (half);
+  region_destroy (region);
+  }
+
+
+/*==========================================================================
+  bench_render_split
+*==========================================================================*/
+static int bench_render_split (char *list, char **items)
+  {
+  int n = 0;
+  char *saveptr = NULL;
+  for (char *s = strtok_r (list, ",", &saveptr);
+       s && n < BENCH_RENDER_MAX_LIST; s = strtok_r (NULL, ",", &saveptr))
+    items[n++] = s;
+  return n;
+  }
+
+
+/*==========================================================================
+  bench_render_usage
+*==========================================================================*/
+static void bench_render_usage (const char *argv0)
+  {
+  fprintf (stderr, "Usage: %s [options]\n", argv0);
+  fprintf (stderr, "  -c         write CSV\n");
+  fprintf (stderr, "  -d LIST    bits per pixel: 16, 24, 32 (%s)\n",
+    BENCH_RENDER_DEF_DEPTHS);
+  fprintf (stderr, "  -m N       msec for each run (%d)\n",
+    BENCH_RENDER_DEF_MSEC);
+  fprintf (stderr, "  -n N       timed runs (%d)\n", BENCH_RENDER_DEF_RUNS);
+  fprintf (stderr, "  -o LIST    operations (%s)\n", BENCH_RENDER_DEF_OPS);
+  fprintf (stderr, "  -s LIST    sizes (%s)\n", BENCH_RENDER_DEF_SIZES);
+  }
+
+
+/*==========================================================================
+  main
+*==========================================================================*/
+int main (int argc, char **argv)
+  {
+  char *sizes = strdup (BENCH_RENDER_DEF_SIZES);
+  char *depths = strdup (BENCH_RENDER_DEF_DEPTHS);
+  char *ops = strdup (BENCH_RENDER_DEF_OPS);
+  int msec = BENCH_RENDER_DEF_MSEC;
+  int runs = BENCH_RENDER_DEF_RUNS;
+  BOOL csv = FALSE;
+  int opt;
+  while ((opt = getopt (argc, argv, "cd:m:n:o:s:")) != -1)
+    {
+    switch (opt)
+      {
+      case 'c': csv = TRUE; break;
+      case 'd': free (depths); depths = strdup (optarg); break;
+      case 'm': msec = atoi (optarg); break;
+      case 'n': runs = atoi (optarg); break;
+      case 'o': free (ops); ops = strdup (optarg); break;
+      case 's': free (sizes); sizes = strdup (optarg); break;
+      default: bench_render_usage (argv[0]); return 2;
+      }
+    }
+
+  char *size_list[BENCH_RENDER_MAX_LIST];
+  char *depth_list[BENCH_RENDER_MAX_LIST];
+  char *op_list[BENCH_RENDER_MAX_LIST];
+  int nsizes = bench_render_split (sizes, size_list);
+  int ndepths = bench_render_split (depths, depth_list);
+  int nops = bench_render_split (ops, op_list);
+
+  // Check everything first, rather than fail half way through
+  int ret = (runs < 1 || msec < 1) ? 2 : 0;
+  int ws[BENCH_RENDER_MAX_LIST], hs[BENCH_RENDER_MAX_LIST];
+  int ds[BENCH_RENDER_MAX_LIST];
+  BenchRenderOp op_ids[BENCH_RENDER_MAX_LIST];
+  for (int i = 0; i < nsizes; i++)
+    {
+    if (sscanf (size_list[i], "%dx%d", &ws[i], &hs[i]) != 2
+        || ws[i] < 2 || hs[i] < 2)
+      {
+      fprintf (stderr, "Bad size: %s\n", size_list[i]);
+      ret = 2;
+      }
+    }
+  for (int i = 0; i < ndepths; i++)
+    {
+    ds[i] = atoi (depth_list[i]);
+    if (ds[i] != 16 && ds[i] != 24 && ds[i] != 32)
+      {
+      fprintf (stderr, "Unsupported depth: %s\n", depth_list[i]);
+      ret = 2;
+      }
+    }
+  for (int i = 0; i < nops; i++)
+    {
+    op_ids[i] = 0;
+    while (op_ids[i] < BENCH_RENDER_NOPS
+        && strcmp (op_list[i], bench_render_op_names [op_ids[i]]) != 0)
+      op_ids[i]++;
+    if (op_ids[i] == BENCH_RENDER_NOPS)
+      {
+      fprintf (stderr, "Unknown operation: %s\n", op_list[i]);
+      ret = 2;
+      }
+    }
+  if (ret) bench_render_usage (argv[0]);
+
+  if (ret == 0)
+    {
+    if (csv)
+      printf ("operation,width,height,bpp,repeats,ms_per_op,"
+        "mpixels_per_s,gb_per_s\n");
+    else
+      printf ("%-13s %11s %3s %7s %10s %10s %8s\n", "operation", "size",
+        "bpp", "repeats", "ms/op", "Mpixels/s", "GB/s");
+    for (int o = 0; o < nops; o++)
+      {
+      BOOL region_only = op_ids[o] < BENCH_RENDER_TO_FB;
+      for (int s = 0; s < nsizes; s++)
+        for (int d = 0; d < (region_only ? 1 : ndepths); d++)
+          bench_render_measure (op_ids[o], ws[s], hs[s],
+            region_only ? 0 : ds[d], msec, runs, csv);
+      }
+    }
+
+  free (sizes);
+  free (depths);
+  free (ops);
+  return ret;
+  }
+
@@ -0,0 +1,602 @@
+/*============================================================================
+
+  fblife
+  tests/check.c
+  Copyright (c)2020 Kevin Boone, GPL v3.0
+
+  The test driver for "make check". It does two things.
+
+  First, it runs known patterns -- a blinker, a glider, the R-pentomino,
+  and the Gosper glider gun -- for a fixed number of generations, on
+  each topology, and compares the result with a "golden" file, in
+  tests/golden, that holds the population and the position of every
+  live cell (and its state, if it is dying). Random soups, from a 
+  fixed seed, are run in the same way under a rule of each of the 
+  other kinds -- von Neumann, hexagonal, isotropic non-totalistic, 
+  Generations, and Larger than Life -- on a torus and a plane, so that
+  each of the engine's update functions is checked. Each case is run
+  three ways: one generation at a time with life_update(), all at
+  once with life_step_n(), and with life_step_n() in short, uneven
+  steps. The larger grids are big enough to be stepped in blocks (see
+  life.c), so this compares the blocked and unblocked paths against
+  each other and the golden file.
+  The golden files were checked against a straightforward reference
+  implementation when they were made; "check -u" writes them again
+  from the current code, which should only be done when the results
+  are meant to change.
+
+  Second, it times some benchmarks -- random soups, under several
+  kinds of rule -- and reports the time per cell per generation. The
+  best of several runs is taken, to reduce the noise. If there is a
+  baseline file, each result is compared with it, and more than
+  CHECK_PERF_TOLERANCE percent slower is a failure, if timing it again
+  does not do any better. If not, the results
+  are written to it, to become the baseline. Timings only mean
+  anything on the machine that made them, so the baseline file is not
+  part of the source.
+
+  Usage: check [-u] [-w] [-P] [-B baseline_file] test_dir
+
+  -u rewrites the golden files, -w rewrites the baseline, and -P skips
+  the benchmarks. The exit value is 0 if everything passed.
+
+============================================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include "defs.h"
+#include "log.h"
+#include "rule.h"
+#include "life.h"
+#include "pattern.h"
+
+// A benchmark that is more than this many percent slower than the
+//   baseline fails
+#define CHECK_PERF_TOLERANCE 10
+// Each benchmark is run this many times, and the best time taken
+#define CHECK_PERF_RUNS 5
+// A benchmark that seems to have got slower is timed again up to this
+//   many times, in case it was just disturbed, before it fails
+#define CHECK_PERF_RETRIES 3
+// Generations in life_step_n()'s uneven steps
+#define CHECK_CHUNK 3
+// Random soups in the golden tests fill squares of this size, at this
+//   density
+#define CHECK_SOUP_SIZE 48
+#define CHECK_SOUP_PERCENT 40
+// The Larger than Life rule that is checked and timed ("Bosco's rule")
+#define CHECK_LTL "R5,C0,M1,S34..58,B34..45,NM"
+
+typedef enum
+  {
+  CHECK_STEP_UPDATE = 0, // life_update(), once per generation
+  CHECK_STEP_N,          // life_step_n(), all at once
+  CHECK_STEP_CHUNKS      // life_step_n(), CHECK_CHUNK at a time
+  } CheckStep;
+
+static const char *check_step_names[] =
+  { "life_update", "life_step_n", "life_step_n in steps" };
+
+typedef struct _CheckCase
+  {
+  const char *pattern; // In tests/patterns, without ".rle", or "soup"
+  const char *kind; // Of rule, for the name of the golden file
+  const char *rule;
+  const char *topology;
+  int w;
+  int h;
+  int generations;
+  } CheckCase;
+
+static const CheckCase check_cases[] =
+  {
+  { "blinker", "life", "B3/S23", "torus", 16, 16, 5 },
+  { "blinker", "life", "B3/S23", "plane", 16, 16, 5 },
+  { "blinker", "life", "B3/S23", "klein", 16, 16, 5 },
+  { "blinker", "life", "B3/S23", "cross", 16, 16, 5 },
+  { "blinker", "life", "B3/S23", "unbounded", 16, 16, 5 },
+  { "glider", "life", "B3/S23", "torus", 32, 24, 200 },
+  { "glider", "life", "B3/S23", "plane", 32, 24, 200 },
+  { "glider", "life", "B3/S23", "klein", 32, 24, 200 },
+  { "glider", "life", "B3/S23", "cross", 32, 24, 200 },
+  { "glider", "life", "B3/S23", "unbounded", 32, 24, 200 },
+  { "glider", "life", "B3/S23", "torus", 520, 520, 100 },
+  { "rpentomino", "life", "B3/S23", "torus", 64, 64, 1103 },
+  { "rpentomino", "life", "B3/S23", "plane", 64, 64, 500 },
+  { "rpentomino", "life", "B3/S23", "klein", 64, 64, 500 },
+  { "rpentomino", "life", "B3/S23", "cross", 64, 64, 500 },
+  { "rpentomino", "life", "B3/S23", "unbounded", 128, 128, 1103 },
+  { "rpentomino", "life", "B3/S23", "torus", 520, 520, 300 },
+  { "gosper", "life", "B3/S23", "torus", 64, 48, 300 },
+  { "gosper", "life", "B3/S23", "plane", 64, 48, 300 },
+  { "gosper", "life", "B3/S23", "klein", 64, 48, 300 },
+  { "gosper", "life", "B3/S23", "cross", 64, 48, 300 },
+  { "gosper", "life", "B3/S23", "unbounded", 64, 48, 300 },
+  { "gosper", "life", "B3/S23", "plane", 520, 520, 200 },
+  { "soup", "vn", "B2/S3V", "torus", 64, 64, 200 },
+  { "soup", "vn", "B2/S3V", "plane", 64, 64, 200 },
+  { "soup", "vn", "B2/S3V", "torus", 520, 520, 100 },
+  { "soup", "vn", "B2/S3V", "plane", 520, 520, 100 },
+  { "soup", "hex", "B2/S34H", "torus", 64, 64, 200 },
+  { "soup", "hex", "B2/S34H", "plane", 64, 64, 200 },
+  { "soup", "hex", "B2/S34H", "torus", 520, 520, 100 },
+  { "soup", "hex", "B2/S34H", "plane", 520, 520, 100 },
+  { "soup", "isotropic", "B2-a/S12", "torus", 64, 64, 200 },
+  { "soup", "isotropic", "B2-a/S12", "plane", 64, 64, 200 },
+  { "soup", "isotropic", "B2-a/S12", "torus", 520, 520, 100 },
+  { "soup", "isotropic", "B2-a/S12", "plane", 520, 520, 100 },
+  { "soup", "generations", "B2/S345/C4", "torus", 64, 64, 200 },
+  { "soup", "generations", "B2/S345/C4", "plane", 64, 64, 200 },
+  { "soup", "generations", "B2/S345/C4", "torus", 520, 520, 100 },
+  { "soup", "generations", "B2/S345/C4", "plane", 520, 520, 100 },
+  { "soup", "ltl", CHECK_LTL, "torus", 64, 64, 100 },
+  { "soup", "ltl", CHECK_LTL, "plane", 64, 64, 100 },
+  { "soup", "ltl", CHECK_LTL, "torus", 520, 520, 100 },
+  { "soup", "ltl", CHECK_LTL, "plane", 520, 520, 100 },
+  { NULL, NULL, NULL, NULL, 0, 0, 0 }
+  };
+
+typedef struct _CheckBench
+  {
+  const char *name;
+  const char *rule;
+  const char *topology;
+  int w;
+  int h;
+  int generations;
+  } CheckBench;
+
+static const CheckBench check_benches[] =
+  {
+  { "life-256-torus", "B3/S23", "torus", 256, 256, 64 },
+  { "life-1024-torus", "B3/S23", "torus", 1024, 1024, 16 },
+  { "life-1024-klein", "B3/S23", "klein", 1024, 1024, 16 },
+  { "life-512-unbounded", "B3/S23", "unbounded", 512, 512, 16 },
+  { "hex-512-torus", "B2/S34H", "torus", 512, 512, 16 },
+  { "generations-512-torus", "B2/S345/C4", "torus", 512, 512, 16 },
+  { "ltl-256-torus", CHECK_LTL, "torus", 256, 256, 8 },
+  { NULL, NULL, NULL, 0, 0, 0 }
+  };
+
+
+/*==========================================================================
+
+  check_create_life
+
+  Returns NULL, having reported the error, if the rule or topology is
+  invalid
+
+*==========================================================================*/
+static Life *check_create_life (const char *rule_name,
+       const char *topology_name, int w, int h)
+  {
+  char *error = NULL;
+  Rule *rule = rule_parse (rule_name, &error);
+  if (rule == NULL)
+    {
+    fprintf (stderr, "Bad rule %s: %s\n", rule_name, error);
+    free (error);
+    return NULL;
+    }
+  LifeTopology topology;
+  Life *life = NULL;
+  if (life_parse_topology (topology_name, &topology))
+    life = life_create (w, h, rule, topology);
+  else
+    fprintf (stderr, "Bad topology %s\n", topology_name);
+  rule_destroy (rule);
+  return life;
+  }
+
+
+/*==========================================================================
+
+  check_describe
+
+  Describe the state of the grid as the golden files do: the
+  population, then the column and row of each cell in the grid, or 
+  the viewport if the grid is unbounded, that is not dead, followed by
+  its state if it is not just alive. The caller must free the result.
+
+*==========================================================================*/
+static char *check_describe (const Life *life)
+  {
+  char *ret = NULL;
+  size_t len = 0;
+  FILE *f = open_memstream (&ret, &len);
+  fprintf (f, "population %d\n", life_get_population (life));
+  for (int y = 0; y < life_get_height (life); y++)
+    for (int x = 0; x < life_get_width (life); x++)
+      {
+      int state = life_get_state (life, x, y);
+      if (state == 1)
+        fprintf (f, "%d %d\n", x, y);
+      else if (state)
+        fprintf (f, "%d %d %d\n", x, y, state);
+      }
+  fclose (f);
+  return ret;
+  }
+
+
+/*==========================================================================
+
+  check_read_file
+
+  Returns NULL if the file can't be read. The caller must free the
+  result.
+
+*==========================================================================*/
+static char *check_read_file (const char *filename)
+  {
+  FILE *f = fopen (filename, "r");
+  if (f == NULL) return NULL;
+  char *ret = NULL;
+  size_t len = 0;
+  FILE *out = open_memstream (&ret, &len);
+  char buff[4096];
+  size_t n;
+  while ((n = fread (buff, 1, sizeof (buff), f)) > 0)
+    fwrite (buff, 1, n, out);
+  fclose (out);
+  fclose (f);
+  return ret;
+  }
+
+
+/*==========================================================================
+
+  check_first_difference
+
+  The number, counting from 1, of the first line at which two texts
+  differ
+
+*==========================================================================*/
+static int check_first_difference (const char *s1, const char *s2)
+  {
+  int line = 1;
+  for (; *s1 && *s1 == *s2; s1++, s2++)
+    if (*s1 == '\n') line++;
+  return line;
+  }
+
+
+/*==========================================================================
+
+  check_fill_soup
+
+  Fill the grid with a random soup or, if it is larger than two 
+  squares of CHECK_SOUP_SIZE, fill one such square around each corner
+  (wrapping round the edges) and one in the middle, so that the soup
+  meets the edges of the grid and the edges of the blocks that it is 
+  stepped in. The random numbers come from a simple generator, not
+  rand(), so that the golden files do not depend on the C library.
+
+*==========================================================================*/
+static void check_fill_soup (Life *life)
+  {
+  int w = life_get_width (life), h = life_get_height (life);
+  unsigned int seed = 1;
+  life_clear (life);
+  for (int square = 0; square < 2; square++)
+    {
+    int size = CHECK_SOUP_SIZE;
+    int x0 = square ? (w - size) / 2 : w - size / 2;
+    int y0 = square ? (h - size) / 2 : h - size / 2;
+    if (w <= 2 * size && h <= 2 * size)
+      {
+      if (square) break;
+      x0 = y0 = 0;
+      size = w > h ? w : h;
+      }
+    for (int j = 0; j < size && j < h; j++)
+      for (int i = 0; i < size && i < w; i++)
+        {
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 100 < CHECK_SOUP_PERCENT)
+          life_set_cell (life, (x0 + i) % w, (y0 + j) % h, 1);
+        }
+    }
+  }
+
+
+/*==========================================================================
+
+  check_run_case
+
+  Run one case, in the given way, and return a description of the
+  result, or NULL if it could not be set up
+
+*==========================================================================*/
+static char *check_run_case (const char *dir, const CheckCase *c,
+       CheckStep step)
+  {
+  Life *life = check_create_life (c->rule, c->topology, c->w, c->h);
+  if (life == NULL) return NULL;
+
+  char *ret = NULL;
+  char *filename, *error = NULL;
+  asprintf (&filename, "%s/patterns/%s.rle", dir, c->pattern);
+  BOOL loaded = TRUE;
+  if (strcmp (c->pattern, "soup") == 0)
+    check_fill_soup (life);
+  else
+    loaded = pattern_load_rle (life, filename, &error);
+  if (loaded)
+    {
+    switch (step)
+      {
+      case CHECK_STEP_UPDATE:
+        for (int i = 0; i < c->generations; i++)
+          life_update (life);
+        break;
+      case CHECK_STEP_N:
+        life_step_n (life, c->generations);
+        break;
+      case CHECK_STEP_CHUNKS:
+        for (int i = 0; i < c->generations; i += CHECK_CHUNK)
+          life_step_n (life, c->generations - i < CHECK_CHUNK
+            ? c->generations - i : CHECK_CHUNK);
+        break;
+      }
+    ret = check_describe (life);
+    }
+  else
+    {
+    fprintf (stderr, "%s\n", error);
+    free (error);
+    }
+  free (filename);
+  life_destroy (life);
+  return ret;
+  }
+
+
+/*==========================================================================
+
+  check_golden
+
+  Run every case, every way, against its golden file or, if update is
+  TRUE, write the golden files. Returns the number of failures.
+
+*==========================================================================*/
+static int check_golden (const char *dir, BOOL update)
+  {
+  int failures = 0;
+  for (const CheckCase *c = check_cases; c->pattern; c++)
+    {
+    char *golden_name;
+    asprintf (&golden_name, "%s/golden/%s-%s-%s-%dx%d-%d.txt", dir,
+      c->pattern, c->kind, c->topology, c->w, c->h, c->generations);
+    char *golden = update ? NULL : check_read_file (golden_name);
+    if (!update && golden == NULL)
+      {
+      printf ("FAIL %s: %s\n", golden_name, strerror (errno));
+      failures++;
+      }
+
+    for (CheckStep step = CHECK_STEP_UPDATE;
+         step <= CHECK_STEP_CHUNKS && (golden || update); step++)
+      {
+      char *result = check_run_case (dir, c, step);
+      if (result == NULL)
+        {
+        printf ("FAIL %s: can't set up the test\n", golden_name);
+        failures++;
+        }
+      else if (update)
+        {
+        if (step == CHECK_STEP_UPDATE)
+          {
+          FILE *f = fopen (golden_name, "w");
+          if (f && fputs (result, f) >= 0 && fclose (f) == 0)
+            printf ("Wrote %s\n", golden_name);
+          else
+            {
+            printf ("FAIL %s: %s\n", golden_name, strerror (errno));
+            failures++;
+            }
+          golden = strdup (result);
+          }
+        else if (strcmp (result, golden) != 0)
+          {
+          printf ("FAIL %s: %s differs from life_update\n",
+            golden_name, check_step_names[step]);
+          failures++;
+          }
+        }
+      else if (strcmp (result, golden) != 0)
+        {
+        printf ("FAIL %s with %s: differs at line %d\n", golden_name,
+          check_step_names[step], check_first_difference (result, golden));
+        failures++;
+        }
+      free (result);
+      }
+    if (!update && golden)
+      printf ("ok   %s %s %s %dx%d, %d generations\n", c->pattern,
+        c->rule, c->topology, c->w, c->h, c->generations);
+    free (golden);
+    free (golden_name);
+    }
+  return failures;
+  }
+
+
+/*==========================================================================
+  check_now
+
+  The CPU time used so far by this thread, in seconds. This is less 
+  disturbed by other programs than the time of day.
+*==========================================================================*/
+static double check_now (void)
+  {
+  struct timespec ts;
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+  }
+
+
+/*==========================================================================
+
+  check_time_bench
+
+  Run a benchmark CHECK_PERF_RUNS times, each time from the same
+  random seed, and return the best time, in nanoseconds per cell per
+  generation, or a negative number if it could not be set up
+
+*==========================================================================*/
+static double check_time_bench (const CheckBench *b)
+  {
+  Life *life = check_create_life (b->rule, b->topology, b->w, b->h);
+  if (life == NULL) return -1;
+  double best = 0;
+  for (int run = 0; run < CHECK_PERF_RUNS; run++)
+    {
+    srand (1);
+    life_seed (life, 30);
+    double start = check_now();
+    life_step_n (life, b->generations);
+    double t = check_now() - start;
+    if (run == 0 || t < best) best = t;
+    }
+  life_destroy (life);
+  return best * 1e9 / ((double)b->w * b->h * b->generations);
+  }
+
+
+/*==========================================================================
+
+  check_read_baseline
+
+  Find the baseline for a benchmark in the text of the baseline file,
+  in which each line is a benchmark name and a time. Returns a
+  negative number if it is not there.
+
+*==========================================================================*/
+static double check_read_baseline (const char *baseline, const char *name)
+  {
+  size_t len = strlen (name);
+  for (const char *s = baseline; s && *s; )
+    {
+    if (strncmp (s, name, len) == 0 && s[len] == ' ')
+      return atof (s + len + 1);
+    s = strchr (s, '\n');
+    if (s) s++;
+    }
+  return -1;
+  }
+
+
+/*==========================================================================
+
+  check_perf
+
+  Time the benchmarks, and compare them with the baseline file or, if
+  it does not exist or rewrite is TRUE, write it. Returns the number
+  of failures.
+
+*==========================================================================*/
+static int check_perf (const char *baseline_name, BOOL rewrite)
+  {
+  int failures = 0;
+  char *baseline = rewrite ? NULL : check_read_file (baseline_name);
+  FILE *out = NULL;
+  if (baseline == NULL)
+    {
+    out = fopen (baseline_name, "w");
+    if (out == NULL)
+      {
+      printf ("FAIL %s: %s\n", baseline_name, strerror (errno));
+      return 1;
+      }
+    fprintf (out, "# Nanoseconds per cell per generation; written by "
+      "'make check' or 'make baseline'\n");
+    }
+
+  for (const CheckBench *b = check_benches; b->name; b++)
+    {
+    double ns = check_time_bench (b);
+    if (ns < 0)
+      {
+      printf ("FAIL %s: can't set up the benchmark\n", b->name);
+      failures++;
+      }
+    else if (out)
+      {
+      fprintf (out, "%s %.3f\n", b->name, ns);
+      printf ("%-24s %8.3f ns/cell (new baseline)\n", b->name, ns);
+      }
+    else
+      {
+      double base = check_read_baseline (baseline, b->name);
+      double limit = base * (100 + CHECK_PERF_TOLERANCE) / 100;
+      for (int i = 0; i < CHECK_PERF_RETRIES && base > 0 && ns > limit; 
+           i++)
+        {
+        double again = check_time_bench (b);
+        if (again < ns) ns = again;
+        }
+      if (base <= 0)
+        printf ("%-24s %8.3f ns/cell (no baseline)\n", b->name, ns);
+      else
+        {
+        double change = (ns - base) * 100 / base;
+        BOOL fail = ns > limit;
+        printf ("%s %-24s %8.3f ns/cell, baseline %.3f (%+.1f%%)\n",
+          fail ? "FAIL" : "ok  ", b->name, ns, base, change);
+        if (fail) failures++;
+        }
+      }
+    }
+
+  if (out)
+    {
+    fclose (out);
+    printf ("Wrote %s\n", baseline_name);
+    }
+  free (baseline);
+  return failures;
+  }
+
+
+/*==========================================================================
+  main
+*==========================================================================*/
+int main (int argc, char **argv)
+  {
+  BOOL update = FALSE, rewrite = FALSE, perf = TRUE;
+  const char *baseline = "perf-baseline.txt";
+  int opt;
+  while ((opt = getopt (argc, argv, "uwPB:")) != -1)
+    {
+    switch (opt)
+      {
+      case 'u': update = TRUE; break;
+      case 'w': rewrite = TRUE; break;
+      case 'P': perf = FALSE; break;
+      case 'B': baseline = optarg; break;
+      default:
+        fprintf (stderr, "Usage: %s [-u] [-w] [-P] [-B baseline_file] "
+          "test_dir\n", argv[0]);
+        return 2;
+      }
+    }
+  const char *dir = optind < argc ? argv[optind] : "tests";
+
+  int failures = check_golden (dir, update);
+  if (perf)
+    failures += check_perf (baseline, rewrite);
+
+  if (failures)
+    printf ("%d failed\n", failures);
+  else
+    printf ("All passed\n");
+  return failures ? 1 : 0;
+  }
+